@@ -0,0 +1,177 @@
+#ifndef TOPAZ_CORE_FRAME_PIPELINE_HPP
+#define TOPAZ_CORE_FRAME_PIPELINE_HPP
+#include "tz/core/job.hpp"
+#include <functional>
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <span>
+#include <cstdint>
+
+namespace tz
+{
+	/**
+	 * @ingroup tz_core_job
+	 * @brief A single stage of a frame. See @ref frame_pipeline.
+	 */
+	enum class frame_phase
+	{
+		/// Gather OS/window events and player input. Runs synchronously on the thread that calls @ref frame_pipeline::run_frame.
+		input,
+		/// Advance the game simulation.
+		simulate,
+		/// Extract everything the renderer needs from the simulation into the frame's render data (e.g build draw lists, write quad transforms).
+		prepare_render,
+		/// Hand the frame's render data to the GPU, e.g via @ref tz::gpu::execute. Runs on the main thread (see @ref job_main_thread).
+		submit,
+		_count
+	};
+
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Passed to each phase of a frame.
+	 */
+	template<typename R>
+	struct frame_context
+	{
+		/// Index of the frame, starting at 0 and increasing by 1 every frame.
+		std::uint64_t index;
+		/// This frame's render data. Written by @ref frame_phase::prepare_render, and read by @ref frame_phase::submit. No other frame touches it in the meantime.
+		R& render_data;
+	};
+
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Runs each frame as a series of phases on the job system, overlapping consecutive frames.
+	 *
+	 * A strictly serial game loop (update, then render, then wait for the GPU) leaves most workers idle most of the time. A frame pipeline splits each frame into @ref frame_phase and runs them as jobs, such that the simulation of frame N+1 runs at the same time as the submission of frame N.
+	 *
+	 * The phases are ordered as follows:
+	 * - Within a frame, each phase runs after the previous one.
+	 * - Each phase runs after the same phase of the previous frame.
+	 * - @ref frame_phase::simulate runs after the previous frame's @ref frame_phase::prepare_render, as that reads the simulation state. This is what makes the overlap safe: once prepare_render has copied what it needs into the frame's render data, the simulation is free to move on.
+	 * - @ref frame_phase::input runs after the previous frame's @ref frame_phase::simulate, as that reads the input state.
+	 *
+	 * The input and submit phases usually talk to the OS or GPU, so both run on the main thread: input runs within @ref frame_pipeline::run_frame, and submit runs as a @ref job_main_thread job. The main thread picks these up whenever it waits on the job system, which run_frame and @ref frame_pipeline::wait_idle both do - so the pipeline must be driven from the main thread. The other phases run as @ref job_priority::realtime jobs on any worker.
+	 *
+	 * Render data is handed from prepare_render to submit via a ring of `R` - one for each frame that can be in flight at once. With the default of 2 frames in flight, this is plain double-buffering.
+	 *
+	 * Example:
+	 * @code
+	 * tz::frame_pipeline<draw_list> pipeline;
+	 * pipeline.set_phase(tz::frame_phase::input, [](auto& frame){tz::os::window_update();});
+	 * pipeline.set_phase(tz::frame_phase::simulate, [&](auto& frame){world.update();});
+	 * pipeline.set_phase(tz::frame_phase::prepare_render, [&](auto& frame){world.build_draw_list(frame.render_data);});
+	 * pipeline.set_phase(tz::frame_phase::submit, [&](auto& frame){frame.render_data.upload(); tz::gpu::execute(graph);});
+	 * while(tz::os::window_is_open())
+	 * {
+	 * 	pipeline.run_frame();
+	 * }
+	 * @endcode
+	 *
+	 * @tparam R Type of the render data handed from @ref frame_phase::prepare_render to @ref frame_phase::submit. Must be default-constructible.
+	 */
+	template<typename R>
+	class frame_pipeline
+	{
+	public:
+		using phase_function = std::function<void(frame_context<R>&)>;
+
+		/**
+		 * Create a new frame pipeline.
+		 * @param max_frames_in_flight Maximum number of frames which may be partially complete at once. 1 means no overlap at all - each frame fully completes before the next one begins. Values less than 1 are treated as 1.
+		 */
+		frame_pipeline(std::size_t max_frames_in_flight = 2):
+		render_data(std::max(max_frames_in_flight, std::size_t{1})),
+		submitted(render_data.size(), tz::nullhand){}
+		frame_pipeline(const frame_pipeline<R>& copy) = delete;
+		frame_pipeline<R>& operator=(const frame_pipeline<R>& rhs) = delete;
+		/// Blocks until all frames in flight have completed.
+		~frame_pipeline()
+		{
+			this->wait_idle();
+		}
+
+		/// Set the function to run for the given phase of every frame. A phase with no function does nothing, but is still ordered as described above. Must not be called while frames are in flight.
+		void set_phase(frame_phase phase, phase_function fn)
+		{
+			this->phases[static_cast<std::size_t>(phase)] = std::move(fn);
+		}
+
+		/**
+		 * Begin a new frame.
+		 *
+		 * Must be called from the main thread. If the maximum number of frames are already in flight, this first waits (helping with pending jobs, including earlier frames' submit phases) until the oldest completes. It then runs the input phase on the calling thread, and queues up the remaining phases as jobs.
+		 *
+		 * @return Handle to a job which completes once the frame's submit phase has completed.
+		 */
+		job_handle run_frame()
+		{
+			const std::uint64_t index = this->frame_count++;
+			const std::size_t slot = index % this->render_data.size();
+			// the frame that last used this slot must be done with its render data before we can reuse it.
+			job_wait(this->submitted[slot]);
+			job_wait(this->last[static_cast<std::size_t>(frame_phase::simulate)]);
+			this->run_phase(frame_phase::input, index, slot);
+
+			std::array<job_handle, 2> sim_deps{this->last[static_cast<std::size_t>(frame_phase::simulate)], this->last[static_cast<std::size_t>(frame_phase::prepare_render)]};
+			const job_handle sim = this->schedule_phase(frame_phase::simulate, index, slot, sim_deps);
+			std::array<job_handle, 1> prepare_deps{sim};
+			const job_handle prepare = this->schedule_phase(frame_phase::prepare_render, index, slot, prepare_deps);
+			std::array<job_handle, 2> submit_deps{prepare, this->last[static_cast<std::size_t>(frame_phase::submit)]};
+			const job_handle submit = this->schedule_phase(frame_phase::submit, index, slot, submit_deps);
+
+			this->last[static_cast<std::size_t>(frame_phase::simulate)] = sim;
+			this->last[static_cast<std::size_t>(frame_phase::prepare_render)] = prepare;
+			this->last[static_cast<std::size_t>(frame_phase::submit)] = submit;
+			this->submitted[slot] = submit;
+			return submit;
+		}
+
+		/// Block until every frame in flight has fully completed.
+		void wait_idle()
+		{
+			for(job_handle frame : this->submitted)
+			{
+				job_wait(frame);
+			}
+		}
+
+		/// Retrieve the maximum number of frames that may be in flight at once.
+		std::size_t max_frames_in_flight() const
+		{
+			return this->render_data.size();
+		}
+	private:
+		void run_phase(frame_phase phase, std::uint64_t index, std::size_t slot)
+		{
+			const phase_function& fn = this->phases[static_cast<std::size_t>(phase)];
+			if(fn)
+			{
+				frame_context<R> ctx{.index = index, .render_data = this->render_data[slot]};
+				fn(ctx);
+			}
+		}
+
+		job_handle schedule_phase(frame_phase phase, std::uint64_t index, std::size_t slot, std::span<const job_handle> dependencies)
+		{
+			job_function fn = [this, phase, index, slot](){this->run_phase(phase, index, slot);};
+			if(phase == frame_phase::submit)
+			{
+				return job_execute_on_after(std::move(fn), job_main_thread, dependencies);
+			}
+			return job_execute_after(std::move(fn), dependencies, job_priority::realtime);
+		}
+
+		std::array<phase_function, static_cast<std::size_t>(frame_phase::_count)> phases = {};
+		// one per frame in flight.
+		std::vector<R> render_data;
+		// submit phase of the frame that last used each render data slot.
+		std::vector<job_handle> submitted;
+		// each phase of the most recent frame.
+		std::array<job_handle, static_cast<std::size_t>(frame_phase::_count)> last = {tz::nullhand, tz::nullhand, tz::nullhand, tz::nullhand};
+		std::uint64_t frame_count = 0;
+	};
+}
+
+#endif // TOPAZ_CORE_FRAME_PIPELINE_HPP
@@ -4,6 +4,7 @@
 #include "tz/core/trs.hpp"
 #include "tz/core/handle.hpp"
 #include <expected>
+#include <span>
 
 namespace tz
 {
@@ -13,11 +14,15 @@ namespace tz
 	 * @brief Represents a single hierarchy.
 	 *
 	 * See @ref create_hier for details.
+	 *
+	 * Nodes are stored as parallel arrays, without a heap allocation per node. Creating or destroying a node never moves any others, so the arrays are only in depth-first order straight after a call to @ref hier_compact. @ref hier_update visits nodes in depth-first order either way.
 	 */
 	using hier_handle = tz::handle<detail::hier_t>;
 	/**
 	 * @ingroup tz_core_transform
 	 * @brief Represents a single node within a hierarchy.
+	 *
+	 * Once a node is destroyed, any handles to it become stale. Stale handles are always detected and rejected, even if a new node has since been created in the destroyed node's place, and checking a handle is constant-time regardless of how many nodes have been destroyed.
 	 */
 	using node_handle = tz::handle<hier_handle>;
 
@@ -51,7 +56,6 @@ namespace tz
 	 * @param hier Hierarchy in which the node is located. This must be the same handle used in the call to @ref hier_create_node.
 	 * @param node Node to destroy.
 	 * @return @ref tz::error_code::invalid_value If `node` is invalid or has already been destroyed.
-	 * @return @ref tz::error_code::unknown_error If destruction of a child node failed.
 	 */
 	tz::error_code hier_destroy_node(hier_handle hier, node_handle node);
 	
@@ -65,12 +69,16 @@ namespace tz
 	/**
 	 * @ingroup tz_core_transform
 	 * @brief Set the local transform of a node.
+	 *
+	 * This marks the cached global transforms of the node and all of its descendants as out-of-date. They are recalculated the next time they are retrieved.
 	 */
 	void hier_node_set_local_transform(hier_handle hier, node_handle node, tz::trs transform);
 	/**
 	 * @ingroup tz_core_transform
 	 * @brief Retrieve the global transform of a node.
 	 *
+	 * Global transforms are cached. If neither the node nor any of its ancestors have moved since the last time this was called, the cached value is returned straight away. Otherwise, it is recalculated - along with that of any ancestors whose cache is also out-of-date.
+	 *
 	 * @return @ref tz::error_code::invalid_value If `hier` or `node` are invalid or have previously been destroyed.
 	 */
 	std::expected<tz::trs, tz::error_code> hier_node_get_global_transform(hier_handle hier, node_handle node);
@@ -79,6 +87,32 @@ namespace tz
 	 * @brief Set the global transform of a node.
 	 */
 	void hier_node_set_global_transform(hier_handle hier, node_handle node, tz::trs transform);
+	/**
+	 * @ingroup tz_core_transform
+	 * @brief Calculate the global transform of every node in the hierarchy in one go.
+	 *
+	 * Call this once per frame, after you've finished moving nodes about, rather than retrieving each node's global transform one at a time. Nodes are visited in depth-first order, and large hierarchies are split into independent subtrees which are spread across all job workers via @ref job_parallel_for. Straight after @ref hier_compact, nodes are stored in that same order, so this becomes a linear scan over contiguous arrays. Only nodes which have moved (or whose ancestors have moved) since they were last calculated are recalculated.
+	 *
+	 * @return Global transform of every node, indexed by node - i.e the global transform of `node` is `ret[hier_node_index(hier, node)]`. The transforms are contiguous in memory, so can be uploaded to the GPU as-is. Entries left behind by destroyed nodes hold the identity transform, until they are reused by new nodes or removed by @ref hier_compact. The span is only valid until the next time a node is created or destroyed.
+	 * @note This must not be called while the hierarchy is being modified on another thread.
+	 */
+	std::span<const tz::trs> hier_update(hier_handle hier);
+	/**
+	 * @ingroup tz_core_transform
+	 * @brief Retrieve the index of a node's global transform within the span returned by @ref hier_update.
+	 *
+	 * A node's index never changes, unless @ref hier_compact is called. The node must be valid, and not have been destroyed.
+	 */
+	std::size_t hier_node_index(hier_handle hier, node_handle node);
+	/**
+	 * @ingroup tz_core_transform
+	 * @brief Defragment the hierarchy, restoring fast traversal.
+	 *
+	 * Creating and destroying nodes is cheap because nothing is moved: new nodes fill the holes left by destroyed ones, wherever they may be. Over time, parents and children end up scattered across memory, and @ref hier_update has to jump around to find them. Compaction moves every node into depth-first order and squeezes out the holes, so that updates go back to being a linear scan. It also releases memory left over from destroyed nodes. It costs a pass over the whole hierarchy, so is best done when a stutter won't be noticed, e.g during a loading screen.
+	 *
+	 * Node handles are looked up through an indirection, so existing handles remain valid and there is nothing to remap - but the result of @ref hier_node_index changes. Handles to destroyed nodes remain stale.
+	 */
+	void hier_compact(hier_handle hier);
 }
 
 #endif // TOPAZ_CORE_HIER_HPP
\ No newline at end of file
@@ -1,7 +1,23 @@
 #ifndef TOPAZ_CORE_JOB_HPP
 #define TOPAZ_CORE_JOB_HPP
 #include "tz/core/handle.hpp"
-#include <functional>
+#include <concepts>
+#include <type_traits>
+#include <utility>
+#include <cstddef>
+#include <new>
+#include <algorithm>
+#include <array>
+#include <span>
+#include <chrono>
+#include <cstdint>
+#include <atomic>
+#include <limits>
+#include <optional>
+#include <stop_token>
+#include <vector>
+#include <ranges>
+#include <memory_resource>
 
 namespace tz
 {
@@ -18,9 +34,215 @@ namespace tz
 	/**
 	 * @ingroup tz_core_job
 	 * @brief Represents a function that will be executed on a job worker via @ref job_execute.
+	 *
+	 * This is a move-only, type-erased `void()` callable, similar to `std::function<void()>`. Unlike `std::function`, it stores any callable of up to @ref job_function::inline_capacity bytes (e.g a lambda with a handful of captures) directly within itself. Jobs are stored in pooled slots, so submitting such a job never allocates memory.
+	 *
+	 * Callables which are larger than this (or not nothrow-move-constructible) still work, but are allocated on the heap.
 	 */
-	using job_function = std::function<void()>;
+	class job_function
+	{
+	public:
+		/// Maximum size of a callable, in bytes, that can be stored without a heap allocation.
+		static constexpr std::size_t inline_capacity = 64;
+
+		job_function() = default;
+		job_function(std::nullptr_t){}
+		template<typename F> requires (!std::is_same_v<std::decay_t<F>, job_function> && std::is_invocable_r_v<void, std::decay_t<F>&>)
+		job_function(F&& f)
+		{
+			using T = std::decay_t<F>;
+			if constexpr(fits_inline<T>)
+			{
+				new (this->storage) T(std::forward<F>(f));
+			}
+			else
+			{
+				*reinterpret_cast<T**>(this->storage) = new T(std::forward<F>(f));
+			}
+			this->ops = &ops_for<T>;
+		}
+		job_function(const job_function& copy) = delete;
+		job_function(job_function&& move) noexcept
+		{
+			*this = std::move(move);
+		}
+		~job_function()
+		{
+			this->reset();
+		}
+		job_function& operator=(const job_function& rhs) = delete;
+		job_function& operator=(job_function&& rhs) noexcept
+		{
+			if(this != &rhs)
+			{
+				this->reset();
+				if(rhs.ops != nullptr)
+				{
+					rhs.ops->relocate(this->storage, rhs.storage);
+					this->ops = std::exchange(rhs.ops, nullptr);
+				}
+			}
+			return *this;
+		}
+		job_function& operator=(std::nullptr_t)
+		{
+			this->reset();
+			return *this;
+		}
+
+		void operator()()
+		{
+			this->ops->invoke(this->storage);
+		}
+
+		explicit operator bool() const
+		{
+			return this->ops != nullptr;
+		}
+	private:
+		void reset()
+		{
+			if(this->ops != nullptr)
+			{
+				this->ops->destroy(this->storage);
+				this->ops = nullptr;
+			}
+		}
+
+		template<typename T>
+		static constexpr bool fits_inline = sizeof(T) <= inline_capacity && alignof(T) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<T>;
+
+		struct operations
+		{
+			void(*invoke)(void* storage);
+			// move-construct into dst from src, and then destroy src.
+			void(*relocate)(void* dst, void* src);
+			void(*destroy)(void* storage);
+		};
+
+		template<typename T>
+		static constexpr operations ops_for
+		{
+			.invoke = [](void* storage)
+			{
+				if constexpr(fits_inline<T>)
+				{
+					(*std::launder(reinterpret_cast<T*>(storage)))();
+				}
+				else
+				{
+					(**reinterpret_cast<T**>(storage))();
+				}
+			},
+			.relocate = [](void* dst, void* src)
+			{
+				if constexpr(fits_inline<T>)
+				{
+					T* from = std::launder(reinterpret_cast<T*>(src));
+					new (dst) T(std::move(*from));
+					from->~T();
+				}
+				else
+				{
+					*reinterpret_cast<T**>(dst) = *reinterpret_cast<T**>(src);
+				}
+			},
+			.destroy = [](void* storage)
+			{
+				if constexpr(fits_inline<T>)
+				{
+					std::launder(reinterpret_cast<T*>(storage))->~T();
+				}
+				else
+				{
+					delete *reinterpret_cast<T**>(storage);
+				}
+			}
+		};
+
+		alignas(std::max_align_t) std::byte storage[inline_capacity];
+		const operations* ops = nullptr;
+	};
 	using job_worker = std::size_t;
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Reserved worker id representing the main thread (i.e the thread which called @ref tz::initialise).
+	 *
+	 * Pass this to @ref job_execute_on to create a job which can only ever run on the main thread. Use this for work that must happen on the main thread, such as OS/window calls, rather than marshalling it there by hand.
+	 *
+	 * The main thread is not a pool worker, so it only runs such jobs when it is:
+	 * - Waiting on a job or counter via @ref job_wait.
+	 * - Calling @ref job_pump_main.
+	 *
+	 * The main thread is not included in @ref job_worker_count.
+	 */
+	constexpr job_worker job_main_thread = std::numeric_limits<job_worker>::max() - 1;
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Describes how urgently a job needs to be run.
+	 *
+	 * Workers always run any available jobs of a higher priority before they consider jobs of a lower priority.
+	 *
+	 * The enumerators are not in order of urgency. @ref job_priority::normal comes first, so that a value-initialised priority (e.g passing `{}`) means the default, not @ref job_priority::realtime.
+	 */
+	enum class job_priority
+	{
+		/// Default priority.
+		normal,
+		/// Frame-critical work which must be picked up before anything else.
+		realtime,
+		/// Non-urgent work, such as asset decoding or streaming. Background jobs can only occupy a limited number of workers at once (see @ref job_set_background_worker_limit), so they can never starve more urgent work.
+		background,
+		_count
+	};
+
+	namespace detail
+	{
+		struct job_counter_access;
+	}
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Counts how many of a group of jobs are yet to complete, so that they can all be waited on at once.
+	 *
+	 * Jobs submitted alongside a counter (e.g via `job_execute(fn, counter)`) increment it on submission, and decrement it once they complete. Calling `job_wait(counter)` waits until the count reaches zero. This is far cheaper than holding on to a handle for each job and waiting on each one in turn, and also works for fan-out where jobs submit more jobs to the same counter.
+	 *
+	 * A counter can be reused as soon as it reaches zero. It must outlive all of the jobs submitted with it - typically this means it lives on the stack of whoever waits on it.
+	 */
+	class job_counter
+	{
+	public:
+		job_counter() = default;
+		job_counter(const job_counter& copy) = delete;
+		job_counter& operator=(const job_counter& rhs) = delete;
+		/// Retrieve the number of jobs submitted with this counter which have not yet completed.
+		std::size_t value() const
+		{
+			return this->count.load(std::memory_order_acquire);
+		}
+	private:
+		friend struct detail::job_counter_access;
+		std::atomic<std::uint32_t> count = 0;
+		// number of threads sleeping in job_wait on this counter.
+		std::atomic<std::uint32_t> waiters = 0;
+		// number of jobs part-way through decrementing the counter. job_wait doesn't return until this is zero, so that nobody touches the counter after it is destroyed.
+		std::atomic<std::uint32_t> releasing = 0;
+	};
+
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Optional extra parameters for a job. See @ref job_execute.
+	 */
+	struct job_options
+	{
+		/// Priority of the job. Jobs of a higher priority are always picked up before those of a lower priority.
+		job_priority priority = job_priority::normal;
+		/// If a stop is requested on this token before the job starts running, it is dropped without running. A job that is already running is not interrupted, but can poll @ref job_cancelled to stop early.
+		std::stop_token cancel = {};
+		/// If the job has not started running by this point in time, it is dropped without running. Use this for speculative work which is worthless if it comes too late.
+		std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt;
+		/// Counter to track the job with, if any. See @ref job_counter.
+		job_counter* counter = nullptr;
+	};
 
 	/**
 	 * @ingroup tz_core_job
@@ -30,10 +252,36 @@ namespace tz
 	 *
 	 * There is no guarantee or hint as to which worker thread ultimately picks up your work. If you need that, consider @ref job_execute_on. There is also no safety mechanism in place for avoiding deadlocks -- there is nothing stopping you from writing race conditions, nor does some hidden feature exist to protect you from them.
 	 *
-	 * - It is safe to execute new jobs within another running job.
-	 * - There is no way to cancel a job, you can only wait for it to finish.
+	 * - It is safe to execute new jobs within another running job. Such jobs are pushed onto the current worker's own queue, where they are most likely to be picked up by that same worker. Idle workers will steal them if not.
+	 * - To be able to cancel a job, or give it a deadline, use the overload taking a @ref job_options.
+	 *
+	 * @param fn Function to execute.
+	 * @param priority Priority of the new job. Jobs of a higher priority are always picked up before those of a lower priority.
+	 */
+	job_handle job_execute(job_function fn, job_priority priority = job_priority::normal);
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Execute a function as a new job, tracked by the given counter.
+	 *
+	 * Behaves exactly like @ref job_execute, except that the counter is incremented now and decremented once the job completes. See @ref job_counter.
+	 */
+	job_handle job_execute(job_function fn, job_counter& counter, job_priority priority = job_priority::normal);
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Execute a function as a new job, which may be cancelled or have a deadline.
+	 *
+	 * Behaves like @ref job_execute, with the extra behaviour described by each member of @ref job_options.
+	 *
+	 * A job that is dropped (due to cancellation or a missed deadline) still completes as normal, as far as everyone else is concerned - its handle reports completion, its counter is decremented, and jobs depending on it are released. Its function simply never runs.
+	 */
+	job_handle job_execute(job_function fn, const job_options& options);
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Query as to whether the job currently running on this thread has been cancelled, or has passed its deadline.
+	 *
+	 * Long-running jobs should poll this periodically and return early if it is true, as nobody needs their result anymore. If the calling thread isn't running a job, or the job has no cancellation token or deadline, this always returns false.
 	 */
-	job_handle job_execute(job_function fn);
+	bool job_cancelled();
 	/**
 	 * @ingroup tz_core_job
 	 * @brief Execute a function as a new job - but can only be picked up by a specific worker.
@@ -46,16 +294,88 @@ namespace tz
 	 * - You know a specific worker thread has a certain state, which the job needs access to.
 	 * - You wish to execute exactly *one* job on *every* worker thread, for whatever reason.
 	 * - You are delusional and think you can do a better job than your OS's scheduler.
+	 *
+	 * A worker always picks up its own affine jobs before anything else, regardless of @ref job_priority.
+	 *
+	 * @param fn Function to execute.
+	 * @param worker Worker to run the job on. Must either be less than @ref job_worker_count, or @ref job_main_thread.
 	 */
 	job_handle job_execute_on(job_function fn, job_worker worker);
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Execute a function as a new job on a specific worker, tracked by the given counter.
+	 *
+	 * Behaves exactly like @ref job_execute_on, except that the counter is incremented now and decremented once the job completes. See @ref job_counter.
+	 */
+	job_handle job_execute_on(job_function fn, job_worker worker, job_counter& counter);
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Execute a function as a new job, but only once all of the given jobs have completed.
+	 *
+	 * The new job is not queued until its last dependency has completed, at which point whichever thread completed that dependency queues it straight away. No thread is blocked or polling in the meantime. Any dependencies that have already completed (or are null handles) are ignored.
+	 *
+	 * @param fn Function to execute.
+	 * @param dependencies Jobs which must complete before `fn` is executed.
+	 * @param priority Priority of the new job once it is queued.
+	 * @return Handle to the new job. You can wait on this handle just like any other job, even if the job hasn't been queued yet.
+	 */
+	job_handle job_execute_after(job_function fn, std::span<const job_handle> dependencies, job_priority priority = job_priority::normal);
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Execute a function as a new job on a specific worker, but only once all of the given jobs have completed.
+	 *
+	 * Combines @ref job_execute_on and @ref job_execute_after. Most useful with @ref job_main_thread, to hand the results of some jobs to work that must run on the main thread - e.g submitting a frame via @ref tz::gpu::execute.
+	 *
+	 * @param fn Function to execute.
+	 * @param worker Worker to run the job on. Must either be less than @ref job_worker_count, or @ref job_main_thread.
+	 * @param dependencies Jobs which must complete before `fn` is executed.
+	 */
+	job_handle job_execute_on_after(job_function fn, job_worker worker, std::span<const job_handle> dependencies);
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Execute many functions as new jobs in one go.
+	 *
+	 * Behaves as if @ref job_execute was invoked on each function in turn, but is much cheaper for large numbers of jobs: everything is queued in bulk, and only as many sleeping workers are woken as there are jobs to take (rather than one wakeup per job).
+	 *
+	 * @param fns Functions to execute. Each function is moved out of the span, leaving it empty.
+	 * @param priority Priority of every job in the batch.
+	 * @return Handle to a single job which completes once every job in the batch has completed. You can wait on this just like any other job. If `fns` is empty, a null handle is returned.
+	 */
+	job_handle job_execute_batch(std::span<job_function> fns, job_priority priority = job_priority::normal);
 	/**
 	 * @ingroup tz_core_job
 	 * @brief Block the current thread until the job specified has been fully completed.
+	 *
+	 * While waiting, the calling thread will pick up and run other pending jobs (preferring those spawned by the job being waited on), and only goes to sleep once there is nothing left to help with. This means it is safe to wait on a job from within another job, even if every worker is doing so at once.
+	 *
+	 * On the main thread, this also runs any jobs submitted to @ref job_main_thread, so it is safe to wait on a job which itself depends on main thread work.
 	 */
 	void job_wait(job_handle job);
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Block the current thread until every job tracked by the counter has completed.
+	 *
+	 * Like waiting on a single job, the calling thread picks up and runs other pending jobs while it waits, so this is safe to call from within a job.
+	 */
+	void job_wait(job_counter& counter);
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Run pending jobs on the main thread, for up to the given amount of time.
+	 *
+	 * Jobs created via `job_execute_on(fn, tz::job_main_thread)` always go first. Once there are none left, the main thread helps out with general work (but never @ref job_priority::background work, so it can't get stuck on something long-running). This returns once the budget has been used up, or there is nothing left to run.
+	 *
+	 * Call this whenever the main thread would otherwise sit idle, such as while waiting on frame sync. The budget is only checked in between jobs, so a long-running job may overrun it.
+	 *
+	 * @pre Must be called from the main thread.
+	 * @param budget Maximum time to spend running jobs. By default, jobs are run until there are none left.
+	 * @return Number of jobs that were run.
+	 */
+	std::size_t job_pump_main(std::chrono::nanoseconds budget = std::chrono::nanoseconds::max());
 	/**
 	 * @ingroup tz_core_job
 	 * @brief Query as to whether the specific job has been fully completed or not.
+	 *
+	 * This is very cheap (no locking), so it is fine to poll it frequently. Once a job has completed, its handle will continue to report completion, even after the job system has reused its internal storage for newer jobs.
 	 */
 	bool job_complete(job_handle job);
 	/**
@@ -70,8 +390,348 @@ namespace tz
 	 * @brief Retrieve the number of worker threads.
 	 *
 	 * The returned value is unaffected by whether these worker threads are currently carrying out work/are idle. You can assume this number will never change throughout your application's runtime.
+	 *
+	 * By default, there is one worker per physical CPU core, minus any reserved cores. You can change this via @ref appinfo::job_workers and @ref appinfo::job_reserved_cores when calling @ref tz::initialise.
 	 */
 	std::size_t job_worker_count();
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Set the maximum number of workers that may be running @ref job_priority::background jobs at any one time.
+	 *
+	 * By default, background jobs may occupy all but one worker. Lowering this guarantees more workers are always free to pick up more urgent work, at the cost of background work taking longer.
+	 *
+	 * A limit of 0 means no worker is set aside for background work - this is the default if there is only one worker. Background jobs then only start while no more urgent work is queued, and only one runs at a time.
+	 *
+	 * A background job that is blocked in @ref job_wait does not count towards the limit until it resumes.
+	 */
+	void job_set_background_worker_limit(std::size_t count);
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Retrieve the maximum number of workers that may be running @ref job_priority::background jobs at any one time. See @ref job_set_background_worker_limit.
+	 */
+	std::size_t job_background_worker_limit();
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Runtime statistics for a single job worker. See @ref job_stats.
+	 *
+	 * All counters are cumulative since the job system was initialised. To see what happened over a frame, take a snapshot every frame and subtract the previous one.
+	 */
+	struct job_worker_stats
+	{
+		/// Number of jobs the worker has run, including ones it ran while waiting on another job.
+		std::uint64_t jobs_executed = 0;
+		/// Number of jobs the worker took from another worker's queue.
+		std::uint64_t jobs_stolen = 0;
+		/// Number of jobs the worker dropped without running, because they were cancelled or missed their deadline. These are not included in @ref job_worker_stats::jobs_executed.
+		std::uint64_t jobs_dropped = 0;
+		/// Time spent running jobs, including the brief searches for the next job in between consecutive ones. If the worker is busy right now, this includes the time it has been busy so far.
+		std::chrono::nanoseconds busy_time = std::chrono::nanoseconds::zero();
+		/// Time spent asleep - either waiting for new jobs to be submitted, or blocked in @ref job_wait with nothing else to help with. If the worker is asleep right now, this includes the time it has been asleep so far.
+		std::chrono::nanoseconds parked_time = std::chrono::nanoseconds::zero();
+		/// Number of times the worker was woken up after going to sleep.
+		std::uint64_t wakeups = 0;
+		/// Number of wakeups after which the worker found nothing to do, and went straight back to sleep.
+		std::uint64_t spurious_wakeups = 0;
+		/// Approximate number of jobs currently in the worker's own queues, waiting to be run or stolen.
+		std::size_t local_queue_depth = 0;
+		/// Approximate number of jobs currently waiting in the worker's affine queue (see @ref job_execute_on).
+		std::size_t affine_queue_depth = 0;
+	};
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Retrieve a snapshot of runtime statistics for the given worker.
+	 *
+	 * This does not lock or allocate, so it is cheap enough to poll for every worker every frame. Counters are updated by each worker as it goes, so the snapshot is not guaranteed to be perfectly consistent with itself - it is for profiling and tuning (e.g spotting under-utilised workers, or grain sizes that are too small), not for synchronisation.
+	 *
+	 * @param worker Worker to query. Must be less than @ref job_worker_count.
+	 */
+	job_worker_stats job_stats(job_worker worker);
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Retrieve the calling thread's scratch allocator, for short-lived allocations within a job.
+	 *
+	 * Every worker owns a linear (bump) allocator. Allocating from it costs a pointer bump and never touches the global heap (or contends with any other thread), and deallocating does nothing at all. Instead, all memory is reclaimed at once when you call @ref job_scratch_reset. Use it for temporaries such as `std::pmr::vector<T>` within a job:
+	 * @code
+	 * std::pmr::vector<entity> visible{tz::job_scratch()};
+	 * @endcode
+	 *
+	 * Threads which are not job workers (e.g your main thread) get their own scratch allocator too.
+	 *
+	 * The allocator grows as needed, but after a reset it keeps the memory it has already got, so once it has grown to fit a typical frame's worth of temporaries, it never allocates again.
+	 *
+	 * @note Memory from the scratch allocator must not be used after the next @ref job_scratch_reset. The allocator belongs to the current thread, so do not pass it to other jobs.
+	 */
+	std::pmr::memory_resource* job_scratch();
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Reclaim all memory allocated from the workers' scratch allocators. See @ref job_scratch.
+	 *
+	 * Call this once per frame, at a point where no job is using scratch memory (typically at the end of the frame, once all of its jobs have been waited on). This resets the scratch allocator of every worker, plus that of the calling thread.
+	 */
+	void job_scratch_reset();
+
+	namespace detail
+	{
+		struct job_graph_t{};
+	}
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Represents a reusable graph of jobs. See @ref create_job_graph for details.
+	 */
+	using job_graph_handle = tz::handle<detail::job_graph_t>;
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Represents a single node within a job graph.
+	 */
+	using job_graph_node = tz::handle<job_graph_handle>;
+
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Create a new empty job graph.
+	 *
+	 * A job graph is a set of functions with dependencies between them, which can be executed as many times as you like via @ref job_graph_execute. This allows you to describe something like a frame's update -> animation -> culling -> upload pipeline once, and then resubmit it every frame without any thread ever blocking on an intermediate step.
+	 *
+	 * @note Creating, modifying and destroying job graphs is not thread-safe.
+	 */
+	job_graph_handle create_job_graph();
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Destroy an existing job graph.
+	 *
+	 * You must not destroy a job graph while an execution of it is still in progress.
+	 */
+	void destroy_job_graph(job_graph_handle graph);
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Add a new function to a job graph.
+	 *
+	 * @param graph Graph to add the function to.
+	 * @param fn Function to be executed as a job every time the graph is executed.
+	 * @param dependencies Nodes within the same graph which must complete before `fn` runs. These must already have been added to the graph, so it is impossible to create a cycle.
+	 * @return Handle to the new node, which can be used as a dependency of subsequently-added nodes.
+	 */
+	job_graph_node job_graph_add(job_graph_handle graph, job_function fn, std::span<const job_graph_node> dependencies = {});
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Execute every function in the graph as jobs, respecting their dependencies.
+	 *
+	 * All of the jobs are submitted immediately - each one will begin as soon as its last dependency completes.
+	 *
+	 * @return Handle to a job which completes once every function in the graph has completed.
+	 */
+	job_handle job_graph_execute(job_graph_handle graph);
+
+	namespace detail
+	{
+		// create a job that isn't queued until job_release_deferred is called - even if it has no other dependencies.
+		job_handle job_execute_deferred(job_function fn, job_priority priority = job_priority::normal);
+		void job_release_deferred(job_handle job);
+
+		bool job_range_should_split(job_priority priority);
+		std::size_t job_range_default_grain(std::size_t count);
+		// priority of the job running on this thread, or normal if there isn't one.
+		job_priority job_current_priority();
+
+		// lazy binary splitting: chew through the range grain-by-grain, but whenever nobody has any of our work queued up to steal, split the remainder in half and hand the top half out as a new job.
+		template<std::invocable<std::size_t> F>
+		void job_range_run(std::size_t begin, std::size_t end, std::size_t grain, const F& fn)
+		{
+			// every split at least halves the range, so we can never split more times than there are bits in a size_t.
+			std::array<job_handle, 64> splits;
+			std::size_t split_count = 0;
+			// work we split off is still part of the caller's work, so it shouldn't queue up behind anything less urgent.
+			const job_priority priority = job_current_priority();
+			while(begin < end)
+			{
+				if(end - begin > grain && split_count < splits.size() && job_range_should_split(priority))
+				{
+					const std::size_t mid = begin + (end - begin) / 2;
+					splits[split_count++] = job_execute([mid, end, grain, &fn](){job_range_run(mid, end, grain, fn);}, priority);
+					end = mid;
+					continue;
+				}
+				const std::size_t chunk_end = std::min(begin + grain, end);
+				for(std::size_t i = begin; i < chunk_end; i++)
+				{
+					fn(i);
+				}
+				begin = chunk_end;
+			}
+			for(std::size_t i = 0; i < split_count; i++)
+			{
+				job_wait(splits[i]);
+			}
+		}
+	}
+
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Execute a function for every index in `[begin, end)`, spread out across all worker threads.
+	 *
+	 * This creates a single job which recursively splits the range in half whenever other workers are in need of work, so the range is only ever split as many times as is actually useful. The returned handle refers to the whole range: it is not complete until `fn` has been invoked for every index.
+	 *
+	 * @param begin First index to process.
+	 * @param end One past the last index to process.
+	 * @param grain Minimum number of indices processed by a worker before it considers splitting off more work. If 0, a grain size will be chosen for you based on the size of the range and the number of workers.
+	 * @param fn Function to invoke for each index, with signature `void(std::size_t)`. It will be invoked from many threads at once.
+	 */
+	template<std::invocable<std::size_t> F>
+	job_handle job_execute_range(std::size_t begin, std::size_t end, std::size_t grain, F fn)
+	{
+		if(grain == 0)
+		{
+			grain = detail::job_range_default_grain(end - begin);
+		}
+		return job_execute([begin, end, grain, fn = std::move(fn)]()
+		{
+			detail::job_range_run(begin, end, grain, fn);
+		});
+	}
+
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Execute a function for every index in `[begin, end)`, spread out across all worker threads, and block until they have all finished.
+	 *
+	 * Behaves like @ref job_execute_range, except the calling thread takes part in the work rather than creating a new job, and this function does not return until `fn` has been invoked for every index. If called from within a job, any work split off is queued at that job's priority.
+	 */
+	template<std::invocable<std::size_t> F>
+	void job_parallel_for(std::size_t begin, std::size_t end, std::size_t grain, const F& fn)
+	{
+		if(grain == 0)
+		{
+			grain = detail::job_range_default_grain(end - begin);
+		}
+		detail::job_range_run(begin, end, grain, fn);
+	}
+
+	namespace detail
+	{
+		// the range is divided into contiguous blocks which are processed in parallel, but always combined in order. this is what makes the result deterministic, and correct for operations that are associative but not commutative.
+		inline std::size_t job_block_count(std::size_t count, std::size_t& grain)
+		{
+			if(grain == 0)
+			{
+				grain = job_range_default_grain(count);
+			}
+			return (count + grain - 1) / grain;
+		}
+	}
+
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Combine every element of a range into a single value, spread out across all worker threads.
+	 *
+	 * Equivalent to `std::reduce(range.begin(), range.end(), identity, op)`. The range is split into blocks, each of which is reduced on its own, and the per-block results are then combined in order. Blocks are processed via @ref job_parallel_for, so the calling thread takes part and this function blocks until the result is ready.
+	 *
+	 * @param range Elements to reduce. Must be random-access and sized.
+	 * @param identity Identity value of `op` - e.g 0 for addition, 1 for multiplication.
+	 * @param op Binary operation with signature `T(T, T)`. It must be associative, but does not need to be commutative. It will be invoked from many threads at once.
+	 * @param grain Number of elements in each block. If 0, a grain size will be chosen for you based on the size of the range and the number of workers.
+	 */
+	template<typename R, typename T, typename Op>
+	requires std::ranges::random_access_range<R> && std::ranges::sized_range<R>
+	T job_parallel_reduce(const R& range, T identity, const Op& op, std::size_t grain = 0)
+	{
+		const auto first = std::ranges::begin(range);
+		const std::size_t count = std::ranges::size(range);
+		const std::size_t block_count = detail::job_block_count(count, grain);
+		// optional rather than plain T, so that each block writes to its own object (std::vector<bool> would pack them into shared bits).
+		std::vector<std::optional<T>> partials(block_count);
+		job_parallel_for(0, block_count, 1, [&](std::size_t block)
+		{
+			T acc = identity;
+			const std::size_t block_end = std::min((block + 1) * grain, count);
+			for(std::size_t i = block * grain; i < block_end; i++)
+			{
+				acc = op(std::move(acc), first[i]);
+			}
+			partials[block].emplace(std::move(acc));
+		});
+		T ret = std::move(identity);
+		for(std::optional<T>& partial : partials)
+		{
+			ret = op(std::move(ret), std::move(*partial));
+		}
+		return ret;
+	}
+
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Specifies whether each output element of @ref job_parallel_scan includes its corresponding input element.
+	 */
+	enum class job_scan_type
+	{
+		/// `out[i]` is the combination of `in[0]` up to and including `in[i]`, like `std::inclusive_scan`.
+		inclusive,
+		/// `out[i]` is the combination of `in[0]` up to but excluding `in[i]` (and `out[0]` is the identity), like `std::exclusive_scan`.
+		exclusive
+	};
+
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Compute a prefix scan (running total) of a range, spread out across all worker threads.
+	 *
+	 * Typical usage is stream compaction: scan a list of 0/1 visibility flags to get each visible element's index in a tightly-packed output.
+	 *
+	 * Uses the work-efficient two-pass algorithm: first each block of the input is reduced in parallel, then the block totals are scanned (serially - there are only a handful), and finally each block is scanned in parallel, seeded with the total of every block before it. This invokes `op` roughly twice per element.
+	 *
+	 * @param in Elements to scan. Must be random-access and sized.
+	 * @param out Where to write the results. Must be random-access, and have at least as many elements as `in`. This may be the same range as `in`, for an in-place scan.
+	 * @param identity Identity value of `op` - e.g 0 for addition.
+	 * @param op Binary operation with signature `T(T, T)`. It must be associative, but does not need to be commutative. It will be invoked from many threads at once.
+	 * @param type Whether to perform an exclusive or inclusive scan.
+	 * @param grain Number of elements in each block. If 0, a grain size will be chosen for you based on the size of the range and the number of workers.
+	 */
+	template<typename R, std::ranges::random_access_range O, typename T, typename Op>
+	requires std::ranges::random_access_range<R> && std::ranges::sized_range<R>
+	void job_parallel_scan(const R& in, O&& out, T identity, const Op& op, job_scan_type type = job_scan_type::exclusive, std::size_t grain = 0)
+	{
+		const auto in_first = std::ranges::begin(in);
+		const auto out_first = std::ranges::begin(out);
+		const std::size_t count = std::ranges::size(in);
+		const std::size_t block_count = detail::job_block_count(count, grain);
+		// pass 1: total of each block. optional for the same reason as in job_parallel_reduce.
+		std::vector<std::optional<T>> offsets(block_count);
+		job_parallel_for(0, block_count, 1, [&](std::size_t block)
+		{
+			T acc = identity;
+			const std::size_t block_end = std::min((block + 1) * grain, count);
+			for(std::size_t i = block * grain; i < block_end; i++)
+			{
+				acc = op(std::move(acc), in_first[i]);
+			}
+			offsets[block].emplace(std::move(acc));
+		});
+		// turn the totals into the starting value of each block.
+		T running = identity;
+		for(std::optional<T>& offset : offsets)
+		{
+			T total = std::move(*offset);
+			*offset = running;
+			running = op(std::move(running), std::move(total));
+		}
+		// pass 2: scan each block, starting from its offset.
+		job_parallel_for(0, block_count, 1, [&](std::size_t block)
+		{
+			T acc = *offsets[block];
+			const std::size_t block_end = std::min((block + 1) * grain, count);
+			for(std::size_t i = block * grain; i < block_end; i++)
+			{
+				// read before writing, in case we're scanning in-place.
+				T value = in_first[i];
+				if(type == job_scan_type::exclusive)
+				{
+					out_first[i] = acc;
+					acc = op(std::move(acc), std::move(value));
+				}
+				else
+				{
+					acc = op(std::move(acc), std::move(value));
+					out_first[i] = acc;
+				}
+			}
+		});
+	}
 }
 
 #endif // TOPAZ_CORE_JOB_HPP
\ No newline at end of file
@@ -0,0 +1,253 @@
+#ifndef TOPAZ_CORE_TASK_HPP
+#define TOPAZ_CORE_TASK_HPP
+#include "tz/core/job.hpp"
+#include "tz/detail/debug.hpp"
+#include <coroutine>
+#include <optional>
+#include <utility>
+#include <exception>
+#include <concepts>
+
+namespace tz
+{
+	template<typename T>
+	class task;
+	template<typename T>
+	job_handle task_execute(task<T>& t, job_priority priority = job_priority::normal);
+
+	namespace detail
+	{
+		struct task_promise_base
+		{
+			// coroutine to resume once we're done, if we were co_awaited by another task.
+			std::coroutine_handle<> continuation = nullptr;
+			// deferred job released once we're done, if we were started via task_execute.
+			job_handle completion = tz::nullhand;
+			// priority given to task_execute. every time we're resumed after awaiting a job, we're resumed at this priority too.
+			job_priority priority = job_priority::normal;
+
+			std::suspend_always initial_suspend() noexcept{return {};}
+
+			struct final_awaiter
+			{
+				bool await_ready() noexcept{return false;}
+				template<typename P>
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<P> coro) noexcept
+				{
+					// careful - once the completion job is released, someone may destroy the task (and thus this frame) at any time. so read everything we need first.
+					std::coroutine_handle<> cont = coro.promise().continuation;
+					job_handle completion = coro.promise().completion;
+					if(completion != tz::nullhand)
+					{
+						job_release_deferred(completion);
+					}
+					if(cont)
+					{
+						return cont;
+					}
+					return std::noop_coroutine();
+				}
+				void await_resume() noexcept{}
+			};
+			final_awaiter final_suspend() noexcept{return {};}
+
+			void unhandled_exception()
+			{
+				std::terminate();
+			}
+		};
+
+		template<typename T>
+		struct task_promise : task_promise_base
+		{
+			std::optional<T> value = std::nullopt;
+
+			task<T> get_return_object();
+			template<typename U>
+			void return_value(U&& v)
+			{
+				this->value.emplace(std::forward<U>(v));
+			}
+		};
+
+		template<>
+		struct task_promise<void> : task_promise_base
+		{
+			task<void> get_return_object();
+			void return_void(){}
+		};
+
+		// how one task co_awaits another.
+		template<typename T>
+		struct task_awaiter
+		{
+			std::coroutine_handle<task_promise<T>> child;
+
+			bool await_ready() noexcept
+			{
+				return !this->child || this->child.done();
+			}
+
+			template<typename P>
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<P> parent) noexcept
+			{
+				// start the child on this thread straight away. it resumes us when it's done.
+				this->child.promise().continuation = parent;
+				if constexpr(std::derived_from<P, task_promise_base>)
+				{
+					// the child is part of our work, so it runs at our priority.
+					this->child.promise().priority = parent.promise().priority;
+				}
+				return this->child;
+			}
+
+			T await_resume()
+			{
+				if constexpr(!std::is_void_v<T>)
+				{
+					return std::move(*this->child.promise().value);
+				}
+			}
+		};
+
+		// how a task co_awaits a job.
+		struct job_awaiter
+		{
+			job_handle job;
+
+			bool await_ready() noexcept
+			{
+				return job_complete(this->job);
+			}
+
+			template<typename P>
+			void await_suspend(std::coroutine_handle<P> coro)
+			{
+				std::array<job_handle, 1> deps{this->job};
+				job_priority priority = job_priority::normal;
+				if constexpr(std::derived_from<P, task_promise_base>)
+				{
+					priority = coro.promise().priority;
+				}
+				job_execute_after([coro](){coro.resume();}, deps, priority);
+			}
+
+			void await_resume() noexcept{}
+		};
+	}
+
+	/**
+	 * @ingroup tz_core_job
+	 * @brief A coroutine which runs on the job system.
+	 *
+	 * Any function returning a `tz::task<T>` is a coroutine. Within it, you can `co_await`:
+	 * - A @ref job_handle - the task is suspended until the job completes, at which point it is resumed on a job worker.
+	 * - Another `tz::task<U>` - the awaited task runs, and once it `co_return`s, this task resumes with its result.
+	 *
+	 * While suspended, a task does not occupy a worker thread. This makes tasks ideal for long chains of asynchronous work (e.g read file -> decode image -> create GPU resource), where each step would otherwise require blocking a worker via @ref job_wait.
+	 *
+	 * Tasks are lazy - calling a coroutine function does not run any of its body. It only starts running once it is either co_awaited by another task, or is started from regular code via @ref task_execute.
+	 *
+	 * @note The `tz::task` object owns the coroutine. You must not destroy it until the coroutine has finished.
+	 */
+	template<typename T = void>
+	class task
+	{
+	public:
+		using promise_type = detail::task_promise<T>;
+
+		task(std::coroutine_handle<promise_type> coro):
+		coro(coro){}
+		task(const task<T>& copy) = delete;
+		task(task<T>&& move):
+		coro(std::exchange(move.coro, nullptr)){}
+		~task()
+		{
+			if(this->coro)
+			{
+				this->coro.destroy();
+			}
+		}
+		task<T>& operator=(const task<T>& rhs) = delete;
+		task<T>& operator=(task<T>&& rhs)
+		{
+			std::swap(this->coro, rhs.coro);
+			return *this;
+		}
+
+		/// Query as to whether the task has run to completion.
+		bool done() const
+		{
+			return this->coro && this->coro.done();
+		}
+
+		/// Retrieve the value the task returned via `co_return`. @pre The task must have completed. See @ref task::done.
+		decltype(auto) get()
+		{
+			tz_assert(this->done(), "attempted to retrieve the result of a task that has not yet completed.");
+			if constexpr(!std::is_void_v<T>)
+			{
+				return *this->coro.promise().value;
+			}
+		}
+
+		auto operator co_await() && noexcept
+		{
+			return detail::task_awaiter<T>{this->coro};
+		}
+
+		template<typename U>
+		friend job_handle task_execute(task<U>& t, job_priority priority);
+	private:
+		std::coroutine_handle<promise_type> coro;
+	};
+
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Start running a task on the job system.
+	 *
+	 * The task is resumed on a job worker as soon as possible. It will then run until its first suspension point, and so on until it is finished.
+	 *
+	 * @param t Task to run. This must not have already been started, and must outlive its own execution.
+	 * @param priority Priority at which the task runs. This applies to the job which first starts the task, and to every job which resumes it after it `co_await`s a job - as well as to any tasks it `co_await`s, and to the job behind the returned handle.
+	 * @return Handle to a job which completes once the task has finished running (not just once it first suspends). You can wait on it via @ref job_wait, or `co_await` it from another task.
+	 */
+	template<typename T>
+	job_handle task_execute(task<T>& t, job_priority priority)
+	{
+		tz_assert(t.coro && !t.coro.done() && t.coro.promise().completion == tz::nullhand, "attempted to execute a task which has already been started.");
+		// the completion job is queued when the task finishes, and anything waiting on the task waits on it - so it's as urgent as the task itself.
+		t.coro.promise().completion = detail::job_execute_deferred([](){}, priority);
+		t.coro.promise().priority = priority;
+		job_handle ret = t.coro.promise().completion;
+		job_execute([coro = t.coro](){coro.resume();}, priority);
+		return ret;
+	}
+
+	/**
+	 * @ingroup tz_core_job
+	 * @brief Allows a @ref task to `co_await` a job.
+	 *
+	 * If the job has not yet completed, the awaiting task is suspended and then resumed on a job worker once the job completes. No thread is blocked in the meantime. The task is resumed at the priority it was given by @ref task_execute.
+	 */
+	inline auto operator co_await(job_handle job) noexcept
+	{
+		return detail::job_awaiter{job};
+	}
+
+	namespace detail
+	{
+		template<typename T>
+		task<T> task_promise<T>::get_return_object()
+		{
+			return {std::coroutine_handle<task_promise<T>>::from_promise(*this)};
+		}
+
+		inline task<void> task_promise<void>::get_return_object()
+		{
+			return {std::coroutine_handle<task_promise<void>>::from_promise(*this)};
+		}
+	}
+}
+
+#endif // TOPAZ_CORE_TASK_HPP
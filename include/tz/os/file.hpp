@@ -1,14 +1,71 @@
 #ifndef TOPAZ_OS_FILE_HPP
 #define TOPAZ_OS_FILE_HPP
 #include "tz/core/error.hpp"
+#include "tz/core/job.hpp"
 #include <string>
 #include <filesystem>
 #include <expected>
+#include <span>
+#include <cstddef>
+#include <cstdint>
 
 namespace tz::os
 {
+	/**
+	 * @ingroup tz_os
+	 * @defgroup tz_os_file File I/O
+	 * @brief Reading and writing files, synchronously or asynchronously.
+	 **/
+
 	std::expected<std::string, tz::error_code> read_file(std::filesystem::path path);
 	tz::error_code write_file(std::filesystem::path path, std::string_view data);
+
+	/**
+	 * @ingroup tz_os_file
+	 * @brief Describes a single asynchronous file read. See @ref read_file_async.
+	 *
+	 * You fill in the path and the buffer to read into. Once the read has completed, @ref file_read_request::bytes_read and @ref file_read_request::status are filled in for you.
+	 **/
+	struct file_read_request
+	{
+		/// Path of the file to read.
+		std::filesystem::path path;
+		/// Buffer to read the file's contents into. The read stops once the buffer is full, or the end of the file is reached - whichever comes first. To read a whole file, size the buffer via `std::filesystem::file_size`.
+		std::span<std::byte> buffer = {};
+		/// Offset into the file, in bytes, from which to start reading.
+		std::uint64_t offset = 0;
+		/// Number of bytes read into the buffer. Set once the read has completed.
+		std::size_t bytes_read = 0;
+		/// Set once the read has completed. @ref tz::error_code::precondition_failure if the file could not be opened, @ref tz::error_code::unknown_error if reading from it failed part-way through, otherwise @ref tz::error_code::success.
+		tz::error_code status = tz::error_code::success;
+	};
+
+	/**
+	 * @ingroup tz_os_file
+	 * @brief Read from a file without blocking the calling thread.
+	 *
+	 * Equivalent to calling @ref read_files_async with a single request.
+	 **/
+	tz::job_handle read_file_async(file_read_request& request);
+	/**
+	 * @ingroup tz_os_file
+	 * @brief Read from many files at once, without blocking the calling thread.
+	 *
+	 * Each file is read into its request's own buffer. Nothing is allocated per file, and the file contents are never copied.
+	 *
+	 * On Linux, the reads are issued via io_uring: every open and read in the batch is submitted to the kernel with a single syscall, and a dedicated I/O thread waits on their completion. No job worker is ever blocked on the disk, and loading many files is bound by disk bandwidth rather than syscall latency. If io_uring is unavailable (e.g an old kernel, or it is blocked by a sandbox), or on other platforms, each read instead runs as a @ref tz::job_priority::background job which performs a regular blocking read.
+	 *
+	 * Example:
+	 * @code
+	 * std::vector<std::byte> data(std::filesystem::file_size("level.bin"));
+	 * tz::os::file_read_request req{.path = "level.bin", .buffer = data};
+	 * tz::job_wait(tz::os::read_file_async(req));
+	 * @endcode
+	 *
+	 * @param requests Reads to perform. These (and their buffers) must stay alive until the returned job completes. Do not touch them in the meantime.
+	 * @return Handle to a job which completes once every read has completed, successfully or not. You can wait on it via @ref tz::job_wait, depend on it via @ref tz::job_execute_after, or `co_await` it from a @ref tz::task. If `requests` is empty, a null handle is returned.
+	 **/
+	tz::job_handle read_files_async(std::span<file_read_request> requests);
 }
 
-#endif // TOPAZ_OS_FILE_HPP
\ No newline at end of file
+#endif // TOPAZ_OS_FILE_HPP
@@ -20,6 +20,12 @@ namespace tz
 		unsigned int major = 1u;
 		/// Minor version of the application.
 		unsigned int minor = 0u;
+		/// Number of job worker threads to create. If 0, one worker is created for each physical CPU core that isn't reserved (see @ref appinfo::job_reserved_cores). SMT siblings (hyperthreads) do not get their own worker.
+		unsigned int job_workers = 0u;
+		/// Number of physical CPU cores to keep free of job workers, e.g for your main thread and render thread. At least one core is always left for job workers.
+		unsigned int job_reserved_cores = 1u;
+		/// Whether each job worker should be pinned to its own physical CPU core. Workers are assigned cores in topology order, so that neighbouring workers (which steal from each other first) share a NUMA node. If the CPU topology cannot be detected, this is ignored.
+		bool job_pin_workers = false;
 
 		// internal evil hackery
 		// if the user opts for a executable icon, TZ_CUSTOM_ICON_ID will be defined by something needed by tz::os internals.
@@ -53,10 +59,11 @@ namespace tz
 
 	namespace detail
 	{
-		void job_system_initialise();
+		void job_system_initialise(appinfo info);
 		void job_system_terminate();
 		void lua_initialise_local();
 		void lua_initialise_all_threads();
+		void file_io_terminate();
 	}
 	namespace gpu
 	{
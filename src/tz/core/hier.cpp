@@ -1,27 +1,73 @@
 #include "tz/core/hier.hpp"
 #include "tz/topaz.hpp"
+#include "tz/core/job.hpp"
 #include <vector>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <cstdint>
 
 namespace tz
 {
-	struct node_data
-	{
-		tz::trs local_transform = {};
-		node_handle parent = tz::nullhand;
-		void* userdata = nullptr;
-
-		std::vector<node_handle> children = {};
-	};
+	constexpr std::uint32_t no_node = std::numeric_limits<std::uint32_t>::max();
 
+	// nodes are stored as parallel arrays, linked into a tree via first-child/next-sibling indices. creating a node never moves any others - it fills the hole left by a destroyed node, or goes on the end. so the arrays are only in depth-first order (where a linear scan visits parents before children, and each subtree is contiguous) right after hier_compact.
 	struct hier_data
 	{
-		std::vector<node_data> nodes = {};
-		std::vector<node_handle> free_list = {};
+		std::vector<tz::trs> local_transforms = {};
+		// cached global transform of each node. only valid for nodes that aren't dirty. holes always hold the identity transform.
+		std::vector<tz::trs> global_transforms = {};
+		// index of each node's parent, or no_node if it's a root.
+		std::vector<std::uint32_t> parents = {};
+		std::vector<std::uint32_t> first_children = {};
+		std::vector<std::uint32_t> next_siblings = {};
+		// so a node can unlink itself without walking all of its siblings.
+		std::vector<std::uint32_t> prev_siblings = {};
+		std::vector<void*> userdata = {};
+		// set whenever the node or one of its ancestors has moved since the global transform was last calculated. if a node is dirty, then so are all of its descendants. not a vector<bool>, as hier_update writes to different elements from different threads.
+		std::vector<std::uint8_t> dirty = {};
+		// slot of each node, so we can get back to its handle. no_node if the node has been destroyed, leaving a hole.
+		std::vector<std::uint32_t> slots = {};
+		std::vector<std::uint32_t> free_nodes = {};
+
+		// node handles refer to slots, which stay put even when hier_compact moves the node about in the arrays above.
+		// current generation of each slot, bumped whenever the node living in that slot is destroyed. a node handle is a (slot, generation) pair, and is only valid if its generation matches that of its slot.
+		std::vector<std::uint32_t> generations = {};
+		// current index of the node living in each slot, or no_node if the slot is free.
+		std::vector<std::uint32_t> indices = {};
+		std::vector<std::uint32_t> free_list = {};
+		// generation given to brand new slots. hier_compact can drop free slots off the end of the table, and if they ever come back, they must not start at a generation that an old stale handle still has.
+		std::uint32_t new_slot_generation = 0;
+
+		// how hier_update walks the nodes. rebuilt whenever nodes have been created or destroyed.
+		// every live node in depth-first order, so parents always come before their children and each subtree is contiguous. if this is the same order the nodes are already stored in (i.e straight after hier_compact), we skip the indirection and scan the arrays directly.
+		std::vector<std::uint32_t> update_order = {};
+		bool update_order_is_storage_order = false;
+		// positions within update_order. nodes near the top with large subtrees are updated one-by-one first, and then the remaining subtrees are updated in parallel.
+		struct update_range{std::uint32_t begin; std::uint32_t end;};
+		std::vector<std::uint32_t> update_serial = {};
+		std::vector<update_range> update_ranges = {};
+		bool update_plan_dirty = true;
 	};
 
 	std::vector<hier_data> hiers = {};
 	std::vector<hier_handle> free_list = {};
 
+	node_handle impl_make_handle(const hier_data& hier, std::uint32_t slot);
+	std::uint32_t impl_node_slot(node_handle node);
+	bool impl_node_valid(const hier_data& hier, node_handle node);
+	std::uint32_t impl_node_index(const hier_data& hier, node_handle node);
+	template<typename F>
+	void impl_walk_subtree(const hier_data& hier, std::uint32_t root, F visit);
+	void impl_mark_dirty(hier_data& hier, std::uint32_t index);
+	const tz::trs& impl_global_transform(hier_data& hier, std::uint32_t index);
+	void impl_update_node(hier_data& hier, std::uint32_t index);
+	void impl_rebuild_update_plan(hier_data& hier);
+	template<typename T>
+	void impl_reorder(std::vector<T>& data, std::span<const std::uint32_t> order);
+	// minimum number of nodes processed by a single job in hier_update.
+	constexpr std::size_t hier_update_grain = 256;
+
 	hier_handle create_hier()
 	{
 		std::size_t ret = hiers.size();
@@ -49,74 +95,131 @@ namespace tz
 	std::expected<node_handle, tz::error_code> hier_create_node(hier_handle hierh, tz::trs transform, node_handle parent, void* userdata)
 	{
 		auto& hier = hiers[hierh.peek()];
-		if(parent != tz::nullhand)
+		if(parent != tz::nullhand && !impl_node_valid(hier, parent))
 		{
-			auto iter = std::find(hier.free_list.begin(), hier.free_list.end(), parent);
-			if(iter != hier.free_list.end())
-			{
-				UNERR(tz::error_code::invalid_value, "Cannot create a new node with parent {} as this node has previously been destroyed.", parent.peek());
-			}
-			if(parent.peek() >= hier.nodes.size())
-			{
-				UNERR(tz::error_code::invalid_value, "Cannot create a new node with parent {} as this is an invalid node", parent.peek());
-			}
+			UNERR(tz::error_code::invalid_value, "Cannot create a new node with parent {} as this is an invalid node, or has previously been destroyed.", parent.peek());
 		}
-		std::size_t ret = hier.nodes.size();
+		const std::uint32_t parent_index = parent == tz::nullhand ? no_node : impl_node_index(hier, parent);
+
+		auto index = static_cast<std::uint32_t>(hier.local_transforms.size());
+		if(hier.free_nodes.size())
+		{
+			index = hier.free_nodes.back();
+			hier.free_nodes.pop_back();
+		}
+		else
+		{
+			hier.local_transforms.emplace_back();
+			hier.global_transforms.emplace_back();
+			hier.parents.push_back(no_node);
+			hier.first_children.push_back(no_node);
+			hier.next_siblings.push_back(no_node);
+			hier.prev_siblings.push_back(no_node);
+			hier.userdata.push_back(nullptr);
+			hier.dirty.push_back(0);
+			hier.slots.push_back(no_node);
+		}
+		auto slot = static_cast<std::uint32_t>(hier.generations.size());
 		if(hier.free_list.size())
 		{
-			ret = hier.free_list.back().peek();
+			slot = hier.free_list.back();
 			hier.free_list.pop_back();
 		}
 		else
 		{
-			hier.nodes.push_back({});
+			hier.generations.push_back(hier.new_slot_generation);
+			hier.indices.push_back(no_node);
 		}
-		node_data& new_node = hier.nodes[ret];
-		new_node =
-		{
-			.local_transform = transform,
-			.parent = parent,
-			.userdata = userdata
-		};
-		if(parent != tz::nullhand)
+		hier.indices[slot] = index;
+
+		hier.local_transforms[index] = transform;
+		hier.global_transforms[index] = {};
+		hier.parents[index] = parent_index;
+		hier.first_children[index] = no_node;
+		hier.next_siblings[index] = no_node;
+		hier.prev_siblings[index] = no_node;
+		hier.userdata[index] = userdata;
+		hier.dirty[index] = 1;
+		hier.slots[index] = slot;
+		if(parent_index != no_node)
 		{
-			hier.nodes[parent.peek()].children.push_back(static_cast<tz::hanval>(ret));
+			// new children go on the front of the list, so there's no need to find the end.
+			const std::uint32_t next = hier.first_children[parent_index];
+			hier.next_siblings[index] = next;
+			if(next != no_node)
+			{
+				hier.prev_siblings[next] = index;
+			}
+			hier.first_children[parent_index] = index;
 		}
+		hier.update_plan_dirty = true;
 
-		return static_cast<tz::hanval>(ret);	
+		return impl_make_handle(hier, slot);
 	}
 
 	tz::error_code hier_destroy_node(hier_handle hierh, node_handle node)
 	{
 		auto& hier = hiers[hierh.peek()];
-		if(hier.nodes.size() <= node.peek())
+		if(!impl_node_valid(hier, node))
 		{
-			RETERR(tz::error_code::invalid_value, "invalid node {} in the context of hierarchy {}", node.peek(), hierh.peek());
-		}	
-		auto iter = std::find(hier.free_list.begin(), hier.free_list.end(), node);
-		if(iter != hier.free_list.end())
+			RETERR(tz::error_code::invalid_value, "invalid node {} in the context of hierarchy {}. It may have already been destroyed.", node.peek(), hierh.peek());
+		}
+		const std::uint32_t index = impl_node_index(hier, node);
+		// unlink from our parent and siblings.
+		const std::uint32_t prev = hier.prev_siblings[index];
+		const std::uint32_t next = hier.next_siblings[index];
+		if(prev != no_node)
 		{
-			RETERR(tz::error_code::invalid_value, "double destroy of node {}", node.peek());
+			hier.next_siblings[prev] = next;
 		}
-		hier.free_list.push_back(node);
-		hier.nodes[node.peek()] = {};
-
-		// delete all child nodes.
-		for(node_handle child : hier.nodes[node.peek()].children)
+		else if(hier.parents[index] != no_node)
 		{
-			auto err = hier_destroy_node(hierh, child);
-			if(err != tz::error_code::success)
-			{
-				RETERR(tz::error_code::unknown_error, "During deletion of node {}, failed to destroy child node {} due to {}", node.peek(), child.peek(), tz::error_code_name(err));
-			}
+			hier.first_children[hier.parents[index]] = next;
+		}
+		if(next != no_node)
+		{
+			hier.prev_siblings[next] = prev;
 		}
+		// we're no longer linked in to anything else, so the walk never leaves our subtree.
+		hier.next_siblings[index] = no_node;
+		// the walk still needs the links, so only find out what to destroy for now.
+		const std::size_t first_hole = hier.free_nodes.size();
+		impl_walk_subtree(hier, index, [&hier](std::uint32_t i)
+		{
+			hier.free_nodes.push_back(i);
+			return true;
+		});
+		for(std::size_t h = first_hole; h < hier.free_nodes.size(); h++)
+		{
+			const std::uint32_t i = hier.free_nodes[h];
+			// any handles to these nodes are now stale.
+			const std::uint32_t slot = hier.slots[i];
+			hier.generations[slot]++;
+			hier.indices[slot] = no_node;
+			hier.free_list.push_back(slot);
+
+			hier.local_transforms[i] = {};
+			hier.global_transforms[i] = {};
+			hier.parents[i] = no_node;
+			hier.first_children[i] = no_node;
+			hier.next_siblings[i] = no_node;
+			hier.prev_siblings[i] = no_node;
+			hier.userdata[i] = nullptr;
+			hier.dirty[i] = 0;
+			hier.slots[i] = no_node;
+		}
+		hier.update_plan_dirty = true;
 
 		return tz::error_code::success;
 	}
 
-	void hier_node_set_local_transform(hier_handle hier, node_handle node, tz::trs transform)
+	void hier_node_set_local_transform(hier_handle hierh, node_handle node, tz::trs transform)
 	{
-		hiers[hier.peek()].nodes[node.peek()].local_transform = transform;
+		auto& hier = hiers[hierh.peek()];
+		tz_assert(impl_node_valid(hier, node), "attempt to set local transform within hierarchy {} of invalid or previously-deleted node {}", hierh.peek(), node.peek());
+		const std::uint32_t index = impl_node_index(hier, node);
+		hier.local_transforms[index] = transform;
+		impl_mark_dirty(hier, index);
 	}
 
 	std::expected<tz::trs, tz::error_code> hier_node_get_local_transform(hier_handle hierh, node_handle node)
@@ -126,58 +229,306 @@ namespace tz
 			UNERR(tz::error_code::invalid_value, "invalid hierarchy {} when retrieving local transform of node {}", hierh.peek(), node.peek());
 		}
 		const auto& hier = hiers[hierh.peek()];
-		if(hier.nodes.size() <= node.peek())
-		{
-			UNERR(tz::error_code::invalid_value, "attempt to retrieve local transform within hierarchy {} of invalid node {}", hierh.peek(), node.peek());
-		}
-		auto iter = std::find(hier.free_list.begin(), hier.free_list.end(), node);
-		if(iter != hier.free_list.end())
+		if(!impl_node_valid(hier, node))
 		{
-			UNERR(tz::error_code::invalid_value, "attempt to retrieve local transform within hierarchy of previously-deleted node {}", hierh.peek(), node.peek());
+			UNERR(tz::error_code::invalid_value, "attempt to retrieve local transform within hierarchy {} of invalid or previously-deleted node {}", hierh.peek(), node.peek());
 		}
-		return hier.nodes[node.peek()].local_transform;
+		return hier.local_transforms[impl_node_index(hier, node)];
 	}
 
 	std::expected<tz::trs, tz::error_code> hier_node_get_global_transform(hier_handle hierh, node_handle node)
 	{
-		tz::trs parent_transform = {};
 		if(hiers.size() <= hierh.peek())
 		{
 			UNERR(tz::error_code::invalid_value, "invalid hierarchy {} when retrieving global transform of node {}", hierh.peek(), node.peek());
 		}
-		const auto& hier = hiers[hierh.peek()];
-		if(hier.nodes.size() <= node.peek())
+		auto& hier = hiers[hierh.peek()];
+		if(!impl_node_valid(hier, node))
 		{
-			UNERR(tz::error_code::invalid_value, "attempt to retrieve global transform within hierarchy {} of invalid node {}", hierh.peek(), node.peek());
+			UNERR(tz::error_code::invalid_value, "attempt to retrieve global transform within hierarchy {} of invalid or previously-deleted node {}", hierh.peek(), node.peek());
 		}
-		auto iter = std::find(hier.free_list.begin(), hier.free_list.end(), node);
-		if(iter != hier.free_list.end())
+		return impl_global_transform(hier, impl_node_index(hier, node));
+	}
+
+	void hier_node_set_global_transform(hier_handle hierh, node_handle node, tz:: trs transform)
+	{
+		auto& hier = hiers[hierh.peek()];
+		tz_assert(impl_node_valid(hier, node), "attempt to set global transform within hierarchy {} of invalid or previously-deleted node {}", hierh.peek(), node.peek());
+		const std::uint32_t parent = hier.parents[impl_node_index(hier, node)];
+		tz::trs parent_global = {};
+		if(parent != no_node)
 		{
-			UNERR(tz::error_code::invalid_value, "attempt to retrieve global transform within hierarchy of previously-deleted node {}", hierh.peek(), node.peek());
+			parent_global = impl_global_transform(hier, parent);
 		}
-		if(hier.nodes[node.peek()].parent != tz::nullhand)
+		hier_node_set_local_transform(hierh, node, parent_global.inverse().combine(transform));
+	}
+
+	std::span<const tz::trs> hier_update(hier_handle hierh)
+	{
+		auto& hier = hiers[hierh.peek()];
+		if(hier.update_plan_dirty)
+		{
+			impl_rebuild_update_plan(hier);
+			hier.update_plan_dirty = false;
+		}
+		auto node_at = [&hier](std::uint32_t position)
+		{
+			return hier.update_order_is_storage_order ? position : hier.update_order[position];
+		};
+		// the nodes at the top first, in order, so that every range's ancestors are up-to-date before it starts.
+		for(std::uint32_t p : hier.update_serial)
+		{
+			impl_update_node(hier, node_at(p));
+		}
+		// no two ranges overlap, and nothing in one range depends on anything in another.
+		tz::job_parallel_for(0, hier.update_ranges.size(), 1, [&hier, &node_at](std::size_t r)
 		{
-			auto maybe_parent_transform = hier_node_get_global_transform(hierh, hier.nodes[node.peek()].parent);
-			if(maybe_parent_transform.has_value())
+			const hier_data::update_range range = hier.update_ranges[r];
+			for(std::uint32_t p = range.begin; p < range.end; p++)
 			{
-				parent_transform = maybe_parent_transform.value();
+				impl_update_node(hier, node_at(p));
 			}
-			else
+		});
+		return hier.global_transforms;
+	}
+
+	std::size_t hier_node_index(hier_handle hierh, node_handle node)
+	{
+		tz_assert(impl_node_valid(hiers[hierh.peek()], node), "attempt to retrieve index within hierarchy {} of invalid or previously-deleted node {}", hierh.peek(), node.peek());
+		return impl_node_index(hiers[hierh.peek()], node);
+	}
+
+	void hier_compact(hier_handle hierh)
+	{
+		auto& hier = hiers[hierh.peek()];
+		// move every node to its position in depth-first order, which also squeezes out the holes.
+		impl_rebuild_update_plan(hier);
+		const std::span<const std::uint32_t> order = hier.update_order;
+		std::vector<std::uint32_t> new_index(hier.slots.size(), no_node);
+		for(std::size_t p = 0; p < order.size(); p++)
+		{
+			new_index[order[p]] = static_cast<std::uint32_t>(p);
+		}
+		impl_reorder(hier.local_transforms, order);
+		impl_reorder(hier.global_transforms, order);
+		impl_reorder(hier.parents, order);
+		impl_reorder(hier.first_children, order);
+		impl_reorder(hier.next_siblings, order);
+		impl_reorder(hier.prev_siblings, order);
+		impl_reorder(hier.userdata, order);
+		impl_reorder(hier.dirty, order);
+		impl_reorder(hier.slots, order);
+		for(auto* links : {&hier.parents, &hier.first_children, &hier.next_siblings, &hier.prev_siblings})
+		{
+			for(std::uint32_t& i : *links)
+			{
+				if(i != no_node)
+				{
+					i = new_index[i];
+				}
+			}
+		}
+		for(std::uint32_t& i : hier.indices)
+		{
+			if(i != no_node)
+			{
+				i = new_index[i];
+			}
+		}
+		hier.free_nodes.clear();
+		hier.free_nodes.shrink_to_fit();
+		// nodes are now exactly where the plan expects them to be.
+		impl_rebuild_update_plan(hier);
+		hier.update_plan_dirty = false;
+
+		// drop free slots off the end of the table.
+		std::vector<bool> slot_free(hier.generations.size(), false);
+		for(std::uint32_t slot : hier.free_list)
+		{
+			slot_free[slot] = true;
+		}
+		std::size_t slot_count = hier.generations.size();
+		while(slot_count > 0 && slot_free[slot_count - 1])
+		{
+			slot_count--;
+			hier.new_slot_generation = std::max(hier.new_slot_generation, hier.generations[slot_count]);
+		}
+		hier.generations.resize(slot_count);
+		hier.indices.resize(slot_count);
+		std::erase_if(hier.free_list, [slot_count](std::uint32_t slot){return slot >= slot_count;});
+		// lowest slots get reused first, so the table doesn't grow back out again.
+		std::sort(hier.free_list.begin(), hier.free_list.end(), std::greater<std::uint32_t>{});
+		hier.generations.shrink_to_fit();
+		hier.indices.shrink_to_fit();
+		hier.free_list.shrink_to_fit();
+		hier.update_serial.shrink_to_fit();
+		hier.update_ranges.shrink_to_fit();
+	}
+
+	node_handle impl_make_handle(const hier_data& hier, std::uint32_t slot)
+	{
+		const std::uint64_t generation = hier.generations[slot];
+		return static_cast<tz::hanval>((generation << 32) | slot);
+	}
+
+	std::uint32_t impl_node_slot(node_handle node)
+	{
+		return static_cast<std::uint32_t>(node.peek() & 0xFFFFFFFF);
+	}
+
+	bool impl_node_valid(const hier_data& hier, node_handle node)
+	{
+		const std::uint32_t slot = impl_node_slot(node);
+		// the null handle's slot is always out of range. destroyed nodes have moved on to a later generation, which no handle has been given out for yet.
+		return slot < hier.generations.size() && hier.generations[slot] == static_cast<std::uint32_t>(node.peek() >> 32);
+	}
+
+	std::uint32_t impl_node_index(const hier_data& hier, node_handle node)
+	{
+		return hier.indices[impl_node_slot(node)];
+	}
+
+	// visit a node and its descendants in depth-first order, without needing a stack. if `visit` returns false, the children of that node are skipped. the root's own siblings are never visited.
+	template<typename F>
+	void impl_walk_subtree(const hier_data& hier, std::uint32_t root, F visit)
+	{
+		std::uint32_t i = root;
+		while(true)
+		{
+			if(visit(i) && hier.first_children[i] != no_node)
+			{
+				i = hier.first_children[i];
+				continue;
+			}
+			while(i != root && hier.next_siblings[i] == no_node)
 			{
-				UNERR(tz::error_code::unknown_error, "error occurred when getting global transform of node {} - {} occurred while getting global transform of parent node", node.peek(), tz::error_code_name(maybe_parent_transform.error()));
+				i = hier.parents[i];
 			}
+			if(i == root)
+			{
+				return;
+			}
+			i = hier.next_siblings[i];
 		}
-		return parent_transform.combine(hier.nodes[node.peek()].local_transform);
 	}
 
-	void hier_node_set_global_transform(hier_handle hier, node_handle node, tz:: trs transform)
+	void impl_mark_dirty(hier_data& hier, std::uint32_t index)
 	{
-		node_handle parent = hiers[hier.peek()].nodes[node.peek()].parent;
+		impl_walk_subtree(hier, index, [&hier](std::uint32_t i)
+		{
+			if(hier.dirty[i])
+			{
+				// descendants must already be dirty too.
+				return false;
+			}
+			hier.dirty[i] = 1;
+			return true;
+		});
+	}
+
+	const tz::trs& impl_global_transform(hier_data& hier, std::uint32_t index)
+	{
+		const std::uint32_t parent = hier.parents[index];
+		if(hier.dirty[index] && parent != no_node)
+		{
+			// only recalculate as far up as the first ancestor that is still clean.
+			impl_global_transform(hier, parent);
+		}
+		impl_update_node(hier, index);
+		return hier.global_transforms[index];
+	}
+
+	// recalculate a node's global transform if it's dirty. its parent must already be clean.
+	void impl_update_node(hier_data& hier, std::uint32_t index)
+	{
+		if(!hier.dirty[index])
+		{
+			return;
+		}
 		tz::trs parent_global = {};
-		if(parent != tz::nullhand)
+		const std::uint32_t parent = hier.parents[index];
+		if(parent != no_node)
+		{
+			parent_global = hier.global_transforms[parent];
+		}
+		hier.global_transforms[index] = parent_global.combine(hier.local_transforms[index]);
+		hier.dirty[index] = 0;
+	}
+
+	void impl_rebuild_update_plan(hier_data& hier)
+	{
+		const std::size_t storage_size = hier.slots.size();
+		hier.update_order.clear();
+		for(std::uint32_t i = 0; i < storage_size; i++)
+		{
+			if(hier.slots[i] != no_node && hier.parents[i] == no_node)
+			{
+				impl_walk_subtree(hier, i, [&hier](std::uint32_t j)
+				{
+					hier.update_order.push_back(j);
+					return true;
+				});
+			}
+		}
+		const std::size_t count = hier.update_order.size();
+		hier.update_order_is_storage_order = count == storage_size;
+		for(std::size_t p = 0; p < count && hier.update_order_is_storage_order; p++)
+		{
+			hier.update_order_is_storage_order = hier.update_order[p] == p;
+		}
+
+		// size of the subtree starting at each position. children always come after their parents, so working backwards adds each subtree to its parent's after it is complete.
+		std::vector<std::uint32_t> position(storage_size, no_node);
+		for(std::size_t p = 0; p < count; p++)
+		{
+			position[hier.update_order[p]] = static_cast<std::uint32_t>(p);
+		}
+		std::vector<std::uint32_t> subtree_sizes(count, 1);
+		for(std::size_t p = count; p-- > 0;)
+		{
+			const std::uint32_t parent = hier.parents[hier.update_order[p]];
+			if(parent != no_node)
+			{
+				subtree_sizes[position[parent]] += subtree_sizes[p];
+			}
+		}
+
+		hier.update_serial.clear();
+		hier.update_ranges.clear();
+		// a few ranges per thread, so the load still balances when some subtrees are much more dirty than others.
+		const std::size_t range_size = std::max(hier_update_grain, count / ((tz::job_worker_count() + 1) * 4));
+		for(std::uint32_t p = 0; p < count;)
+		{
+			const std::uint32_t size = subtree_sizes[p];
+			if(size > range_size)
+			{
+				// too big to give to a single job, so split it up amongst its children instead.
+				hier.update_serial.push_back(p);
+				p++;
+				continue;
+			}
+			// lump small neighbouring subtrees together.
+			if(hier.update_ranges.size() && hier.update_ranges.back().end == p && hier.update_ranges.back().end - hier.update_ranges.back().begin + size <= range_size)
+			{
+				hier.update_ranges.back().end += size;
+			}
+			else
+			{
+				hier.update_ranges.push_back({.begin = p, .end = p + size});
+			}
+			p += size;
+		}
+	}
+
+	template<typename T>
+	void impl_reorder(std::vector<T>& data, std::span<const std::uint32_t> order)
+	{
+		std::vector<T> ret;
+		ret.reserve(order.size());
+		for(std::uint32_t i : order)
 		{
-			parent_global = tz_must(hier_node_get_global_transform(hier, parent));
+			ret.push_back(data[i]);
 		}
-		hier_node_set_local_transform(hier, node, transform.combine(parent_global.inverse()));
+		data = std::move(ret);
 	}
-}
\ No newline at end of file
+}
@@ -1,197 +1,1708 @@
 #include "tz/core/job.hpp"
+#include "tz/topaz.hpp"
 #include "concurrentqueue.h"
 #include "tz/detail/debug.hpp"
 #include <thread>
 #include <deque>
+#include <vector>
+#include <memory>
+#include <array>
+#include <algorithm>
 #include <optional>
 #include <mutex>
 #include <atomic>
+#include <limits>
 #include <chrono>
+#include <filesystem>
+#include <map>
+#include <tuple>
+#include <cstdlib>
+#include <memory_resource>
+#include <cstdint>
 
 #ifdef _WIN32
 #define NOMINMAX
 #include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#include <fstream>
+#include <format>
+#include <string>
 #endif
 
 namespace tz
 {
 	// state begin
 
+	constexpr job_worker job_worker_none = std::numeric_limits<job_worker>::max();
+	struct job_continuation;
+
+	// jobs live in pooled slots which are recycled as soon as the job finishes. every recycle bumps the slot's generation, so a job handle is just a (slot, generation) pair, and the job is complete once its slot has moved on to a later generation.
 	struct job_data
 	{
 		job_function fn;
-		std::size_t job_id;
 		std::optional<job_worker> affinity = std::nullopt;
+		// atomic as job_wait peeks at it, and the slot may be recycled at any time.
+		std::atomic<job_priority> priority = job_priority::normal;
+		std::uint32_t slot_id;
+		std::atomic<std::uint32_t> generation = 0;
+		// number of threads blocked in job_wait on this slot. completion only bothers notifying if this is non-zero.
+		std::atomic<std::uint32_t> waiters = 0;
+		// worker currently running the job, if any. anything it spawns ends up in that worker's deque.
+		std::atomic<job_worker> executor = job_worker_none;
+		// number of unfinished jobs that must complete before this one is queued.
+		std::atomic<std::uint32_t> pending_dependencies = 0;
+		// jobs to release once this one has finished. only touched while holding continuation_lock.
+		job_continuation* continuations = nullptr;
+		std::atomic_flag continuation_lock;
+		// group job of the batch this job was submitted as part of, if any. the group completes once all of its jobs have.
+		job_data* group = nullptr;
+		// counter to decrement once the job completes, if any.
+		job_counter* counter = nullptr;
+		// if either of these say so by the time we get round to running the job, it is dropped instead.
+		std::stop_token cancel = {};
+		std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt;
+	};
+
+	// a single dependency edge. these are pooled, a job can depend on any number of others.
+	struct job_continuation
+	{
+		job_data* job;
+		job_continuation* next;
+	};
+
+	// Chase-Lev work-stealing deque (see "Correct and Efficient Work-Stealing for Weak Memory Models", Le et al. 2013)
+	// the owning worker pushes and pops at the bottom (LIFO), while any other thread steals from the top (FIFO).
+	class job_deque
+	{
+	public:
+		job_deque()
+		{
+			this->rings.push_back(std::make_unique<ring>(initial_capacity));
+			this->buffer = this->rings.back().get();
+		}
+
+		// owner only.
+		void push(job_data* job)
+		{
+			std::int64_t b = this->bottom.load(std::memory_order_relaxed);
+			std::int64_t t = this->top.load(std::memory_order_acquire);
+			ring* r = this->buffer.load(std::memory_order_relaxed);
+			if(b - t > static_cast<std::int64_t>(r->capacity) - 1)
+			{
+				r = this->grow(r, b, t);
+			}
+			r->put(b, job);
+			std::atomic_thread_fence(std::memory_order_release);
+			this->bottom.store(b + 1, std::memory_order_relaxed);
+		}
+
+		// owner only.
+		job_data* pop()
+		{
+			std::int64_t b = this->bottom.load(std::memory_order_relaxed) - 1;
+			ring* r = this->buffer.load(std::memory_order_relaxed);
+			this->bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			std::int64_t t = this->top.load(std::memory_order_relaxed);
+			if(t > b)
+			{
+				// deque was already empty.
+				this->bottom.store(b + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+			job_data* ret = r->get(b);
+			if(t == b)
+			{
+				// last element. race against any thieves for it.
+				if(!this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					ret = nullptr;
+				}
+				this->bottom.store(b + 1, std::memory_order_relaxed);
+			}
+			return ret;
+		}
+
+		// any thread.
+		job_data* steal()
+		{
+			std::int64_t t = this->top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			std::int64_t b = this->bottom.load(std::memory_order_acquire);
+			if(t >= b)
+			{
+				return nullptr;
+			}
+			ring* r = this->buffer.load(std::memory_order_acquire);
+			job_data* ret = r->get(t);
+			if(!this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			{
+				// lost the race to the owner or another thief.
+				return nullptr;
+			}
+			return ret;
+		}
+
+		std::size_t size_approx() const
+		{
+			std::int64_t b = this->bottom.load(std::memory_order_relaxed);
+			std::int64_t t = this->top.load(std::memory_order_relaxed);
+			return static_cast<std::size_t>(std::max(b - t, std::int64_t{0}));
+		}
+	private:
+		static constexpr std::size_t initial_capacity = 256;
+
+		struct ring
+		{
+			ring(std::size_t capacity):
+			capacity(capacity),
+			data(std::make_unique<std::atomic<job_data*>[]>(capacity)){}
+
+			job_data* get(std::int64_t i) const
+			{
+				return this->data[static_cast<std::size_t>(i) & (this->capacity - 1)].load(std::memory_order_relaxed);
+			}
+
+			void put(std::int64_t i, job_data* job)
+			{
+				this->data[static_cast<std::size_t>(i) & (this->capacity - 1)].store(job, std::memory_order_relaxed);
+			}
+
+			std::size_t capacity;
+			std::unique_ptr<std::atomic<job_data*>[]> data;
+		};
+
+		ring* grow(ring* old, std::int64_t b, std::int64_t t)
+		{
+			// only the owner ever grows. old rings are retired, not freed - a thief may still be reading from one.
+			this->rings.push_back(std::make_unique<ring>(old->capacity * 2));
+			ring* r = this->rings.back().get();
+			for(std::int64_t i = t; i < b; i++)
+			{
+				r->put(i, old->get(i));
+			}
+			this->buffer.store(r, std::memory_order_release);
+			return r;
+		}
+
+		std::atomic<std::int64_t> top = 0;
+		std::atomic<std::int64_t> bottom = 0;
+		std::atomic<ring*> buffer = nullptr;
+		std::vector<std::unique_ptr<ring>> rings = {};
+	};
+
+	// a physical cpu core, and the logical processors (i.e SMT siblings) which belong to it.
+	struct cpu_core
+	{
+		// empty if we couldn't detect the topology, in which case there's nothing to pin to.
+		std::vector<std::size_t> logical_processors = {};
+		std::size_t numa_node = 0;
+		std::size_t processor_group = 0;
+	};
+
+	// size of a scratch arena's first block. it grows from there if needed.
+	constexpr std::size_t job_scratch_initial_size = 64 * 1024;
+	// linear allocator behind job_scratch. owned by a single thread, and reset all at once by job_scratch_reset.
+	class scratch_arena : public std::pmr::memory_resource
+	{
+	public:
+		void reset()
+		{
+			if(this->blocks.size() > 1)
+			{
+				// last frame didn't fit in one block. replace them all with a single block big enough for the whole lot, so next frame does.
+				std::size_t total = 0;
+				for(const block& b : this->blocks)
+				{
+					total += b.size;
+				}
+				this->blocks.clear();
+				this->add_block(total);
+			}
+			this->current = 0;
+			this->cursor = 0;
+		}
+	private:
+		struct block
+		{
+			std::unique_ptr<std::byte[]> data;
+			std::size_t size;
+		};
+
+		void add_block(std::size_t size)
+		{
+			this->blocks.push_back({.data = std::make_unique<std::byte[]>(size), .size = size});
+		}
+
+		void* do_allocate(std::size_t bytes, std::size_t alignment) override
+		{
+			while(this->current < this->blocks.size())
+			{
+				block& b = this->blocks[this->current];
+				const std::size_t begin = (reinterpret_cast<std::uintptr_t>(b.data.get()) + this->cursor + alignment - 1) / alignment * alignment - reinterpret_cast<std::uintptr_t>(b.data.get());
+				if(begin + bytes <= b.size)
+				{
+					this->cursor = begin + bytes;
+					return b.data.get() + begin;
+				}
+				this->current++;
+				this->cursor = 0;
+			}
+			// out of space. each new block is at least double the size of the last, so this quickly settles down.
+			this->add_block(std::max({this->blocks.empty() ? job_scratch_initial_size : this->blocks.back().size * 2, bytes + alignment}));
+			return this->do_allocate(bytes, alignment);
+		}
+
+		void do_deallocate([[maybe_unused]] void* p, [[maybe_unused]] std::size_t bytes, [[maybe_unused]] std::size_t alignment) override{}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+		{
+			return this == &other;
+		}
+
+		std::vector<block> blocks = {};
+		std::size_t current = 0;
+		std::size_t cursor = 0;
+	};
+
+	// idle workers briefly spin before parking. the spin count doubles every time it finds work and halves every time it doesn't, within these bounds.
+	constexpr std::size_t job_park_spin_min = 1;
+	constexpr std::size_t job_park_spin_initial = 16;
+	constexpr std::size_t job_park_spin_max = 256;
+
+	enum class worker_state : std::uint8_t
+	{
+		// looking for work, or spinning before it parks.
+		idle,
+		// running jobs.
+		busy,
+		// asleep, either because there's no work or because it's blocked in job_wait.
+		parked
 	};
 
 	struct worker_data
 	{
 		std::thread thread;
 		job_worker my_id;
-		std::atomic<std::size_t> current_job;
-		moodycamel::ConcurrentQueue<job_data> affine_jobs;
+		// core the worker is pinned to, if any.
+		std::optional<cpu_core> core = std::nullopt;
+		// one deque per priority lane.
+		std::array<job_deque, static_cast<std::size_t>(job_priority::_count)> local_jobs;
+		moodycamel::ConcurrentQueue<job_data*> affine_jobs;
+		// parking (see impl_park). the worker sleeps on wake_epoch, and whoever flips sleeping from true to false is responsible for bumping it.
+		std::atomic<std::uint32_t> wake_epoch = 0;
+		std::atomic<bool> sleeping = false;
+		// while the worker sleeps inside job_wait (see impl_worker_sleep), this is the job or counter it's waiting on. whoever completes that wakes it.
+		std::atomic<const void*> waiting_on = nullptr;
+		// set while it sleeps inside a job_wait that won't pick up background work, so there's no point waking it for any.
+		std::atomic<bool> refuses_background = false;
+		// how many times to spin looking for work before parking. adapts to how often spinning actually pays off.
+		std::size_t spin_limit = job_park_spin_initial;
+		scratch_arena scratch;
+		// statistics. only ever written by this worker, but read by anyone via job_stats.
+		std::atomic<std::uint64_t> jobs_executed = 0;
+		std::atomic<std::uint64_t> jobs_stolen = 0;
+		std::atomic<std::uint64_t> jobs_dropped = 0;
+		// busy/parked time only covers states the worker has since left. the state it's in right now, and when it entered it, are published alongside so job_stats can add on the time spent so far - otherwise a worker that is busy (or asleep) for a whole frame would look like it did nothing. all four are written together under stats_sequence, a seqlock, so a reader never adds the current state's time on top of a total that already includes it.
+		std::atomic<std::uint64_t> busy_ns = 0;
+		std::atomic<std::uint64_t> parked_ns = 0;
+		std::atomic<worker_state> state = worker_state::idle;
+		std::atomic<std::uint64_t> state_since_ns = 0;
+		std::atomic<std::uint32_t> stats_sequence = 0;
+		std::atomic<std::uint64_t> wakeups = 0;
+		std::atomic<std::uint64_t> spurious_wakeups = 0;
 	};
 
 	std::deque<worker_data> workers;
-	moodycamel::ConcurrentQueue<job_data> jobs;
+	// jobs submitted from outside of a worker thread go here. workers grab from it when their own deque is empty.
+	std::array<moodycamel::ConcurrentQueue<job_data*>, static_cast<std::size_t>(job_priority::_count)> jobs;
+	// background jobs may only occupy this many threads at once, so that there's always someone left over for frame-critical work. zero means there's no worker to spare (see impl_try_begin_background).
+	std::atomic<std::size_t> background_worker_limit = 0;
+	std::atomic<std::size_t> background_workers_active = 0;
 	std::atomic<bool> requires_exit = false;
-	std::atomic<std::size_t> lifetime_count = 0;
-	std::vector<std::size_t> waiting_job_ids = {};
-	std::mutex waiting_job_id_mutex;
-	std::mutex wake_mutex;
-	std::condition_variable wake_condition;
+	constexpr std::size_t job_slot_chunk_size = 1024;
+	constexpr std::size_t job_slot_max_chunks = 4096;
+	// slot chunks are only ever allocated, never moved or freed (until terminate), so a slot can be looked up without locking.
+	std::array<std::atomic<job_data*>, job_slot_max_chunks> job_slot_chunks = {};
+	std::atomic<std::uint32_t> job_slot_count = 0;
+	std::mutex job_slot_chunk_mutex;
+	moodycamel::ConcurrentQueue<std::uint32_t> free_job_slots;
+	moodycamel::ConcurrentQueue<job_continuation*> free_continuations;
+	// number of workers with sleeping == true. lets submitters skip looking for someone to wake when nobody is asleep.
+	std::atomic<std::size_t> sleeping_workers = 0;
+	// generic wakeups start looking for sleepers from here, so the same few workers aren't always the ones woken.
+	std::atomic<std::size_t> wake_cursor = 0;
+	thread_local worker_data* this_worker = nullptr;
+	// job currently running on this thread, if any.
+	thread_local job_data* current_job = nullptr;
+	// whether this thread is running a background job, and so is counted in background_workers_active.
+	thread_local bool holding_background = false;
+	// scratch allocator used by threads that aren't workers.
+	thread_local scratch_arena external_scratch;
+	// jobs that can only run on the main thread (see job_main_thread).
+	moodycamel::ConcurrentQueue<job_data*> main_jobs;
+	thread_local bool on_main_thread = false;
+	// the main thread parks much like a worker does (see impl_park), but only while waiting inside job_wait.
+	std::atomic<std::uint32_t> main_wake_epoch = 0;
+	std::atomic<bool> main_sleeping = false;
 
-	job_handle impl_execute_job(job_data job);
-	void impl_wait();
+	struct job_graph_data
+	{
+		struct node
+		{
+			job_function fn;
+			std::vector<std::size_t> dependencies = {};
+			bool has_dependents = false;
+		};
+		std::vector<node> nodes = {};
+		// scratch space used during execution, kept around so that resubmitting the graph every frame doesn't allocate.
+		std::vector<job_handle> handles = {};
+		std::vector<job_handle> dependency_handles = {};
+	};
+	std::vector<job_graph_data> job_graphs = {};
+	std::vector<job_graph_handle> job_graph_free_list = {};
+
+	job_handle impl_execute_job(job_function fn, std::optional<job_worker> affinity, const job_options& options);
+	job_handle impl_execute_after(job_function fn, std::span<const job_handle> dependencies, job_priority priority, std::optional<job_worker> affinity);
+	job_data& impl_acquire_slot();
+	void impl_acquire_slots(std::span<job_data*> slots);
+	job_data& impl_get_slot(std::uint32_t slot_id);
+	job_handle impl_make_handle(const job_data& job);
+	std::uint32_t impl_handle_slot(job_handle job);
+	std::uint32_t impl_handle_generation(job_handle job);
+	bool impl_add_continuation(job_handle dependency, job_data& dependent);
+	void impl_submit(job_data* job);
+	void impl_wake(std::size_t count, bool background = false);
+	void impl_wake_worker(worker_data& worker);
+	void impl_wake_main();
+	void impl_wake_waiters(const void* target);
+	template<typename F>
+	void impl_main_sleep(F done);
+	template<typename F>
+	void impl_worker_sleep(worker_data& me, const void* target, bool allow_background, F done);
+	job_data* impl_find_job(worker_data* me, job_worker preferred_victim = job_worker_none, bool allow_background = true);
+	void impl_run_job(job_data* job);
+	bool impl_should_drop(const job_data& job);
+	std::uint64_t impl_now_ns();
+	bool impl_suspend_background();
+	void impl_resume_background(bool suspended);
+	// how many times job_wait yields with nothing to do before it goes to sleep.
+	constexpr std::size_t job_wait_spin_count = 16;
+	// job_execute_batch queues jobs in chunks of this many, so it never needs to allocate scratch space.
+	constexpr std::size_t job_batch_chunk_size = 256;
 
 	// state end, api begin
 
-	job_handle job_execute(job_function fn)
+	job_handle job_execute(job_function fn, job_priority priority)
 	{
-		return impl_execute_job
-		({
-			.fn = fn,
-			.job_id = lifetime_count.load(),
-			.affinity = std::nullopt
-		});
+		return impl_execute_job(std::move(fn), std::nullopt, {.priority = priority});
 	}
 
 	job_handle job_execute_on(job_function fn, job_worker worker)
 	{
-		return impl_execute_job
-		({
-			.fn = fn,
-			.job_id = lifetime_count.load(),
-			.affinity = worker
-		});
+		return impl_execute_job(std::move(fn), worker, {});
 	}
 
-	void job_wait(job_handle job)
+	job_handle job_execute(job_function fn, job_counter& counter, job_priority priority)
 	{
-		while(!job_complete(job))
-		{
-			impl_wait();
-		}
+		return impl_execute_job(std::move(fn), std::nullopt, {.priority = priority, .counter = &counter});
 	}
 
-	bool job_complete(job_handle job)
+	job_handle job_execute_on(job_function fn, job_worker worker, job_counter& counter)
 	{
-		std::unique_lock<std::mutex> lock(waiting_job_id_mutex);
-		bool job_isnt_waiting = std::find(waiting_job_ids.begin(), waiting_job_ids.end(), job.peek()) == waiting_job_ids.end();
-		bool no_workers_doing_it = std::all_of(workers.begin(), workers.end(), [jid = job.peek()](const worker_data& worker){return worker.current_job != jid;});
-		return job_isnt_waiting && no_workers_doing_it;
+		return impl_execute_job(std::move(fn), worker, {.counter = &counter});
 	}
 
-	std::size_t job_count()
+	job_handle job_execute(job_function fn, const job_options& options)
 	{
-		return jobs.size_approx();
+		return impl_execute_job(std::move(fn), std::nullopt, options);
 	}
 
-	std::size_t job_worker_count()
+	bool job_cancelled()
 	{
-		return std::thread::hardware_concurrency();
+		return current_job != nullptr && impl_should_drop(*current_job);
 	}
 
-	// api end, init/term
-	constexpr std::size_t job_id_null = std::numeric_limits<std::size_t>::max();
+	job_handle job_execute_after(job_function fn, std::span<const job_handle> dependencies, job_priority priority)
+	{
+		return impl_execute_after(std::move(fn), dependencies, priority, std::nullopt);
+	}
 
-	void impl_wait()
+	job_handle job_execute_on_after(job_function fn, job_worker worker, std::span<const job_handle> dependencies)
 	{
-		std::this_thread::sleep_for(std::chrono::duration<int, std::micro>(10));
+		return impl_execute_after(std::move(fn), dependencies, job_priority::normal, worker);
 	}
 
-	void impl_tmain(std::size_t tid)
+	job_handle impl_execute_after(job_function fn, std::span<const job_handle> dependencies, job_priority priority, std::optional<job_worker> affinity)
 	{
-		worker_data& me = workers[tid];
-		while(!requires_exit.load())
+		job_data* data = &impl_acquire_slot();
+		data->fn = std::move(fn);
+		data->affinity = affinity;
+		data->priority.store(priority, std::memory_order_relaxed);
+		const job_handle ret = impl_make_handle(*data);
+		// hold on to an extra dependency while registering the real ones, otherwise the job could be queued before we're done.
+		data->pending_dependencies.store(1, std::memory_order_relaxed);
+		for(job_handle dependency : dependencies)
+		{
+			data->pending_dependencies.fetch_add(1, std::memory_order_relaxed);
+			if(!impl_add_continuation(dependency, *data))
+			{
+				// dependency has already finished.
+				data->pending_dependencies.fetch_sub(1, std::memory_order_relaxed);
+			}
+		}
+		if(data->pending_dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			impl_submit(data);
+		}
+		return ret;
+	}
+
+	job_handle job_execute_batch(std::span<job_function> fns, job_priority priority)
+	{
+		if(fns.empty())
+		{
+			return tz::nullhand;
+		}
+		// the group is a job with nothing to run. it is never queued - the last job in the batch to finish releases it directly.
+		job_data* group = &impl_acquire_slot();
+		group->priority.store(priority, std::memory_order_relaxed);
+		group->pending_dependencies.store(static_cast<std::uint32_t>(fns.size()), std::memory_order_relaxed);
+		const job_handle ret = impl_make_handle(*group);
+		const auto lane = static_cast<std::size_t>(priority);
+		std::array<job_data*, job_batch_chunk_size> chunk;
+		for(std::size_t offset = 0; offset < fns.size(); offset += job_batch_chunk_size)
+		{
+			const std::span<job_data*> slots{chunk.data(), std::min(job_batch_chunk_size, fns.size() - offset)};
+			impl_acquire_slots(slots);
+			for(std::size_t i = 0; i < slots.size(); i++)
+			{
+				slots[i]->fn = std::move(fns[offset + i]);
+				slots[i]->priority.store(priority, std::memory_order_relaxed);
+				slots[i]->group = group;
+			}
+			if(this_worker != nullptr)
+			{
+				for(job_data* job : slots)
+				{
+					this_worker->local_jobs[lane].push(job);
+				}
+			}
+			else
+			{
+				jobs[lane].enqueue_bulk(slots.begin(), slots.size());
+			}
+		}
+		// if we're a worker, we'll be taking one of the jobs ourselves.
+		impl_wake(this_worker != nullptr ? fns.size() - 1 : fns.size(), priority == job_priority::background);
+		return ret;
+	}
+
+	void job_wait(job_handle job)
+	{
+		if(job == tz::nullhand)
+		{
+			return;
+		}
+		const std::uint32_t generation = impl_handle_generation(job);
+		job_data& data = impl_get_slot(impl_handle_slot(job));
+		// read before checking the generation. if the slot has already been recycled by then, we never use it.
+		const bool waiting_on_background = data.priority.load(std::memory_order_relaxed) == job_priority::background;
+		const bool suspended = impl_suspend_background();
+		std::size_t idle_count = 0;
+		while(data.generation.load(std::memory_order_acquire) == generation)
+		{
+			// rather than sit around, run other jobs until ours is done. whoever is running our job is where its children will be, so try to steal from them first.
+			// don't get stuck running some long-running background job unless that's what we're waiting on anyway.
+			job_data* other = impl_find_job(this_worker, data.executor.load(std::memory_order_relaxed), waiting_on_background);
+			if(other != nullptr)
+			{
+				impl_run_job(other);
+				idle_count = 0;
+				continue;
+			}
+			if(idle_count++ < job_wait_spin_count)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			// nothing left to help with - our job must be running elsewhere. sleep until its generation changes.
+			data.waiters++;
+			if(on_main_thread)
+			{
+				impl_main_sleep([&data, generation](){return data.generation.load() != generation;});
+			}
+			else if(this_worker != nullptr)
+			{
+				impl_worker_sleep(*this_worker, &data, waiting_on_background, [&data, generation](){return data.generation.load() != generation;});
+			}
+			else
+			{
+				data.generation.wait(generation);
+			}
+			data.waiters--;
+		}
+		impl_resume_background(suspended);
+	}
+
+	namespace detail
+	{
+		struct job_counter_access
 		{
-			job_data job;
+			static void increment(job_counter& counter)
+			{
+				counter.count.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			static void decrement(job_counter& counter)
+			{
+				counter.releasing++;
+				// needs to be seq_cst against the waiter count, otherwise a job_wait that is about to sleep could miss the notify.
+				if(counter.count.fetch_sub(1) == 1 && counter.waiters.load() > 0)
+				{
+					counter.count.notify_all();
+					impl_wake_waiters(&counter);
+				}
+				// last time we touch the counter - the waiter may destroy it any time after this.
+				counter.releasing--;
+			}
+
+			static void wait(job_counter& counter)
 			{
-				std::unique_lock<std::mutex> lock(wake_mutex);
-				while(!requires_exit.load() && !jobs.try_dequeue(job))
+				const bool suspended = impl_suspend_background();
+				std::size_t idle_count = 0;
+				std::uint32_t count;
+				while((count = counter.count.load(std::memory_order_acquire)) != 0)
 				{
-					// no jobs. how about affine jobs?
-					if(me.affine_jobs.try_dequeue(job))
+					// we have no idea which jobs are ours, so help with anything - including background work, in case that's what we're waiting on.
+					job_data* other = impl_find_job(this_worker);
+					if(other != nullptr)
+					{
+						impl_run_job(other);
+						idle_count = 0;
+						continue;
+					}
+					if(idle_count++ < job_wait_spin_count)
+					{
+						std::this_thread::yield();
+						continue;
+					}
+					counter.waiters++;
+					if(on_main_thread)
+					{
+						impl_main_sleep([&counter, count](){return counter.count.load() != count;});
+					}
+					else if(this_worker != nullptr)
+					{
+						impl_worker_sleep(*this_worker, &counter, true, [&counter, count](){return counter.count.load() != count;});
+					}
+					else
 					{
-						// we have an affine job.
-						me.current_job = job.job_id;
-						job.fn();
-						me.current_job = job_id_null;
+						counter.count.wait(count);
 					}
-					wake_condition.wait(lock);
+					counter.waiters--;
+				}
+				// the count hit zero, but the job that got it there might still be in the middle of notifying us.
+				while(counter.releasing.load(std::memory_order_acquire) != 0)
+				{
+					std::this_thread::yield();
 				}
+				impl_resume_background(suspended);
 			}
-			if(requires_exit.load())
+		};
+	}
+
+	void job_wait(job_counter& counter)
+	{
+		detail::job_counter_access::wait(counter);
+	}
+
+	std::size_t job_pump_main(std::chrono::nanoseconds budget)
+	{
+		tz_assert(on_main_thread, "job_pump_main must only be called from the main thread");
+		const auto begin = std::chrono::steady_clock::now();
+		std::size_t ret = 0;
+		job_data* job;
+		// impl_find_job prefers main thread jobs over everything else.
+		while((job = impl_find_job(nullptr, job_worker_none, false)) != nullptr)
+		{
+			impl_run_job(job);
+			ret++;
+			if(std::chrono::steady_clock::now() - begin >= budget)
 			{
 				break;
 			}
-			me.current_job = job.job_id;
+		}
+		return ret;
+	}
+
+	bool job_complete(job_handle job)
+	{
+		if(job == tz::nullhand)
+		{
+			return true;
+		}
+		return impl_get_slot(impl_handle_slot(job)).generation.load(std::memory_order_acquire) != impl_handle_generation(job);
+	}
+
+	std::size_t job_count()
+	{
+		std::size_t ret = 0;
+		for(std::size_t lane = 0; lane < jobs.size(); lane++)
+		{
+			ret += jobs[lane].size_approx();
+			for(const worker_data& worker : workers)
+			{
+				ret += worker.local_jobs[lane].size_approx();
+			}
+		}
+		for(const worker_data& worker : workers)
+		{
+			ret += worker.affine_jobs.size_approx();
+		}
+		return ret + main_jobs.size_approx();
+	}
+
+	std::size_t job_worker_count()
+	{
+		return workers.size();
+	}
+
+	void job_set_background_worker_limit(std::size_t count)
+	{
+		background_worker_limit = count;
+	}
+
+	std::size_t job_background_worker_limit()
+	{
+		return background_worker_limit.load();
+	}
+
+	job_worker_stats job_stats(job_worker worker)
+	{
+		tz_assert(worker < workers.size(), "attempted to retrieve stats for worker {}, but there are only {} workers", worker, workers.size());
+		const worker_data& w = workers[worker];
+		job_worker_stats ret;
+		ret.jobs_executed = w.jobs_executed.load(std::memory_order_relaxed);
+		ret.jobs_stolen = w.jobs_stolen.load(std::memory_order_relaxed);
+		ret.jobs_dropped = w.jobs_dropped.load(std::memory_order_relaxed);
+		std::uint64_t busy_ns, parked_ns, state_since_ns;
+		worker_state state;
+		std::uint32_t sequence;
+		do
+		{
+			// odd means the worker is part-way through changing state.
+			while((sequence = w.stats_sequence.load(std::memory_order_acquire)) & 1)
 			{
-				std::unique_lock<std::mutex> lock(waiting_job_id_mutex);
-				auto iter = std::find(waiting_job_ids.begin(), waiting_job_ids.end(), job.job_id);
-				tz_assert(iter != waiting_job_ids.end(), "job system thread took a job, but its id is not on the list of waiting jobs???");
-				waiting_job_ids.erase(iter);
+				std::this_thread::yield();
 			}
-			job.fn();
-			me.current_job = job_id_null;
+			busy_ns = w.busy_ns.load(std::memory_order_relaxed);
+			parked_ns = w.parked_ns.load(std::memory_order_relaxed);
+			state = w.state.load(std::memory_order_relaxed);
+			state_since_ns = w.state_since_ns.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+		}while(w.stats_sequence.load(std::memory_order_relaxed) != sequence);
+		const std::uint64_t now = impl_now_ns();
+		const std::uint64_t current = now > state_since_ns ? now - state_since_ns : 0;
+		if(state == worker_state::busy)
+		{
+			busy_ns += current;
+		}
+		else if(state == worker_state::parked)
+		{
+			parked_ns += current;
+		}
+		ret.busy_time = std::chrono::nanoseconds{busy_ns};
+		ret.parked_time = std::chrono::nanoseconds{parked_ns};
+		ret.wakeups = w.wakeups.load(std::memory_order_relaxed);
+		ret.spurious_wakeups = w.spurious_wakeups.load(std::memory_order_relaxed);
+		for(const job_deque& deque : w.local_jobs)
+		{
+			ret.local_queue_depth += deque.size_approx();
+		}
+		ret.affine_queue_depth = w.affine_jobs.size_approx();
+		return ret;
+	}
+
+	std::pmr::memory_resource* job_scratch()
+	{
+		if(this_worker != nullptr)
+		{
+			return &this_worker->scratch;
+		}
+		return &external_scratch;
+	}
+
+	void job_scratch_reset()
+	{
+		for(worker_data& worker : workers)
+		{
+			worker.scratch.reset();
 		}
+		external_scratch.reset();
 	}
 
-	job_handle impl_execute_job(job_data job)
+	job_graph_handle create_job_graph()
 	{
-		if(job.affinity.has_value())
+		std::size_t ret = job_graphs.size();
+		if(job_graph_free_list.size())
 		{
-			auto val = job.affinity.value();
-			auto& q = workers[val].affine_jobs;
-			q.enqueue(job);
-			wake_condition.notify_all();
+			ret = job_graph_free_list.back().peek();
+			job_graph_free_list.pop_back();
 		}
 		else
 		{
+			job_graphs.push_back({});
+		}
+		return static_cast<tz::hanval>(ret);
+	}
+
+	void destroy_job_graph(job_graph_handle graph)
+	{
+		job_graphs[graph.peek()] = {};
+		job_graph_free_list.push_back(graph);
+	}
+
+	job_graph_node job_graph_add(job_graph_handle graphh, job_function fn, std::span<const job_graph_node> dependencies)
+	{
+		auto& graph = job_graphs[graphh.peek()];
+		const std::size_t ret = graph.nodes.size();
+		auto& node = graph.nodes.emplace_back();
+		node.fn = std::move(fn);
+		for(job_graph_node dep : dependencies)
+		{
+			tz_assert(dep.peek() < ret, "job graph node {} cannot depend on node {} as it has not been added to the graph yet", ret, dep.peek());
+			node.dependencies.push_back(dep.peek());
+			graph.nodes[dep.peek()].has_dependents = true;
+		}
+		return static_cast<tz::hanval>(ret);
+	}
+
+	job_handle job_graph_execute(job_graph_handle graphh)
+	{
+		auto& graph = job_graphs[graphh.peek()];
+		graph.handles.resize(graph.nodes.size());
+		// nodes can only depend on nodes added before them, so submitting in order means every dependency already has a handle.
+		for(std::size_t i = 0; i < graph.nodes.size(); i++)
+		{
+			auto& node = graph.nodes[i];
+			graph.dependency_handles.clear();
+			for(std::size_t dep : node.dependencies)
+			{
+				graph.dependency_handles.push_back(graph.handles[dep]);
+			}
+			graph.handles[i] = job_execute_after([fn = &node.fn](){(*fn)();}, graph.dependency_handles);
+		}
+		// the graph as a whole is done once every node that nothing depends on is done.
+		graph.dependency_handles.clear();
+		for(std::size_t i = 0; i < graph.nodes.size(); i++)
+		{
+			if(!graph.nodes[i].has_dependents)
 			{
-				std::unique_lock<std::mutex> lock(waiting_job_id_mutex);
-				waiting_job_ids.push_back(lifetime_count);
+				graph.dependency_handles.push_back(graph.handles[i]);
 			}
-			jobs.enqueue(job);
-			wake_condition.notify_one();
-			lifetime_count++;
 		}
-		return static_cast<tz::hanval>(job.job_id);
+		return job_execute_after([](){}, graph.dependency_handles);
 	}
 
-
 	namespace detail
 	{
-		void job_system_initialise()
+		job_handle job_execute_deferred(job_function fn, job_priority priority)
 		{
-			#ifdef _WIN32
-				timeBeginPeriod(1u);
-			#endif
-			for(std::size_t i = 0; i < job_worker_count(); i++)
+			job_data* data = &impl_acquire_slot();
+			data->fn = std::move(fn);
+			data->priority.store(priority, std::memory_order_relaxed);
+			// this is a dependency held by the caller, which is only dropped by job_release_deferred.
+			data->pending_dependencies.store(1, std::memory_order_relaxed);
+			return impl_make_handle(*data);
+		}
+
+		void job_release_deferred(job_handle job)
+		{
+			job_data* data = &impl_get_slot(impl_handle_slot(job));
+			if(data->pending_dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
 			{
-				auto& worker = workers.emplace_back();
-				worker.thread = std::thread([i](){impl_tmain(i);});
-				worker.my_id = i;
-				worker.current_job = job_id_null;
+				impl_submit(data);
 			}
 		}
 
-		void job_system_terminate()
+		bool job_range_should_split(job_priority priority)
 		{
+			// only split if we have nothing queued up for other workers to steal.
+			const auto lane = static_cast<std::size_t>(priority);
+			if(this_worker != nullptr)
 			{
-				std::unique_lock<std::mutex> lock(wake_mutex);
-				requires_exit = true;
+				return this_worker->local_jobs[lane].size_approx() == 0;
 			}
-			wake_condition.notify_all();
-			for(worker_data& worker : workers)
+			return jobs[lane].size_approx() == 0;
+		}
+
+		std::size_t job_range_default_grain(std::size_t count)
+		{
+			// lazy splitting means the grain doesn't need to be very precise - aim for a handful of chunks per worker.
+			return std::max(count / (std::max(workers.size(), std::size_t{1}) * 8), std::size_t{1});
+		}
+
+		job_priority job_current_priority()
+		{
+			if(current_job != nullptr)
 			{
-				worker.thread.join();
+				return current_job->priority.load(std::memory_order_relaxed);
 			}
-			workers.clear();
-			#ifdef _WIN32
-				timeEndPeriod(1u);
-			#endif
+			return job_priority::normal;
+		}
+	}
+
+	// api end, init/term
+
+	job_data& impl_get_slot(std::uint32_t slot_id)
+	{
+		return job_slot_chunks[slot_id / job_slot_chunk_size].load(std::memory_order_acquire)[slot_id % job_slot_chunk_size];
+	}
+
+	std::uint32_t impl_new_slot()
+	{
+		const std::uint32_t slot_id = job_slot_count++;
+		const std::size_t chunk = slot_id / job_slot_chunk_size;
+		tz_assert(chunk < job_slot_max_chunks, "ran out of job slots. there are more than {} jobs in flight at once", job_slot_chunk_size * job_slot_max_chunks);
+		if(job_slot_chunks[chunk].load(std::memory_order_acquire) == nullptr)
+		{
+			std::unique_lock<std::mutex> lock(job_slot_chunk_mutex);
+			if(job_slot_chunks[chunk].load(std::memory_order_relaxed) == nullptr)
+			{
+				auto* new_chunk = new job_data[job_slot_chunk_size];
+				for(std::size_t i = 0; i < job_slot_chunk_size; i++)
+				{
+					new_chunk[i].slot_id = static_cast<std::uint32_t>(chunk * job_slot_chunk_size + i);
+				}
+				job_slot_chunks[chunk].store(new_chunk, std::memory_order_release);
+			}
+		}
+		return slot_id;
+	}
+
+	job_data& impl_acquire_slot()
+	{
+		std::uint32_t slot_id;
+		if(!free_job_slots.try_dequeue(slot_id))
+		{
+			// no free slots, make a new one.
+			slot_id = impl_new_slot();
+		}
+		return impl_get_slot(slot_id);
+	}
+
+	void impl_acquire_slots(std::span<job_data*> slots)
+	{
+		std::array<std::uint32_t, job_batch_chunk_size> slot_ids;
+		tz_assert(slots.size() <= slot_ids.size(), "cannot acquire more than {} slots at once", slot_ids.size());
+		std::size_t count = free_job_slots.try_dequeue_bulk(slot_ids.begin(), slots.size());
+		for(; count < slots.size(); count++)
+		{
+			slot_ids[count] = impl_new_slot();
+		}
+		for(std::size_t i = 0; i < slots.size(); i++)
+		{
+			slots[i] = &impl_get_slot(slot_ids[i]);
+		}
+	}
+
+	job_handle impl_make_handle(const job_data& job)
+	{
+		const std::uint64_t generation = job.generation.load(std::memory_order_relaxed);
+		return static_cast<tz::hanval>((generation << 32) | job.slot_id);
+	}
+
+	std::uint32_t impl_handle_slot(job_handle job)
+	{
+		return static_cast<std::uint32_t>(job.peek() & 0xFFFFFFFF);
+	}
+
+	std::uint32_t impl_handle_generation(job_handle job)
+	{
+		return static_cast<std::uint32_t>(job.peek() >> 32);
+	}
+
+	void impl_lock_continuations(job_data& job)
+	{
+		while(job.continuation_lock.test_and_set(std::memory_order_acquire))
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	void impl_unlock_continuations(job_data& job)
+	{
+		job.continuation_lock.clear(std::memory_order_release);
+	}
+
+	bool impl_add_continuation(job_handle dependency, job_data& dependent)
+	{
+		if(dependency == tz::nullhand)
+		{
+			return false;
+		}
+		job_continuation* cont;
+		if(!free_continuations.try_dequeue(cont))
+		{
+			cont = new job_continuation;
+		}
+		job_data& job = impl_get_slot(impl_handle_slot(dependency));
+		const std::uint32_t generation = impl_handle_generation(dependency);
+		bool added = false;
+		impl_lock_continuations(job);
+		// the generation is only ever bumped while this lock is held, so if it still matches then the job is guaranteed to see our continuation when it finishes.
+		if(job.generation.load(std::memory_order_relaxed) == generation)
+		{
+			cont->job = &dependent;
+			cont->next = job.continuations;
+			job.continuations = cont;
+			added = true;
+		}
+		impl_unlock_continuations(job);
+		if(!added)
+		{
+			free_continuations.enqueue(cont);
+		}
+		return added;
+	}
+
+	void impl_release_slot(job_data& job)
+	{
+		job_data* group = std::exchange(job.group, nullptr);
+		job_counter* counter = std::exchange(job.counter, nullptr);
+		job.cancel = {};
+		job.deadline = std::nullopt;
+		job.fn = nullptr;
+		job.affinity = std::nullopt;
+		job.priority.store(job_priority::normal, std::memory_order_relaxed);
+		job.executor.store(job_worker_none, std::memory_order_relaxed);
+		impl_lock_continuations(job);
+		job_continuation* cont = job.continuations;
+		job.continuations = nullptr;
+		// pairs with the acquire in job_complete, so whoever sees the new generation also sees everything the job did.
+		// also needs to be seq_cst against the waiter count, otherwise a job_wait that is about to sleep could miss the notify.
+		job.generation.fetch_add(1);
+		impl_unlock_continuations(job);
+		if(job.waiters.load() > 0)
+		{
+			job.generation.notify_all();
+			impl_wake_waiters(&job);
+		}
+		// release anything that was waiting on us. if we were the last thing they were waiting on, they're ready to go.
+		while(cont != nullptr)
+		{
+			job_continuation* next = cont->next;
+			job_data* dependent = cont->job;
+			free_continuations.enqueue(cont);
+			if(dependent->pending_dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				impl_submit(dependent);
+			}
+			cont = next;
+		}
+		free_job_slots.enqueue(job.slot_id);
+		// the last job of a batch to finish completes the batch.
+		if(group != nullptr && group->pending_dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			impl_release_slot(*group);
+		}
+		if(counter != nullptr)
+		{
+			detail::job_counter_access::decrement(*counter);
+		}
+	}
+
+	bool impl_urgent_work_queued()
+	{
+		for(job_priority priority : {job_priority::realtime, job_priority::normal})
+		{
+			const auto lane = static_cast<std::size_t>(priority);
+			if(jobs[lane].size_approx() > 0 || std::any_of(workers.begin(), workers.end(), [lane](const worker_data& worker){return worker.local_jobs[lane].size_approx() > 0;}))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// whether another thread may start on background work, given how many already are.
+	bool impl_background_allowed(std::size_t active)
+	{
+		const std::size_t limit = background_worker_limit.load();
+		if(limit == 0)
+		{
+			// no worker to spare (i.e there's only one). background work still has to happen eventually, so it gets the worker - but only while nothing more urgent is queued.
+			return active == 0 && !impl_urgent_work_queued();
+		}
+		return active < limit;
+	}
+
+	bool impl_try_begin_background()
+	{
+		std::size_t active = background_workers_active.load();
+		while(impl_background_allowed(active))
+		{
+			if(background_workers_active.compare_exchange_weak(active, active + 1))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool impl_background_work_queued()
+	{
+		constexpr auto lane = static_cast<std::size_t>(job_priority::background);
+		return jobs[lane].size_approx() > 0 || std::any_of(workers.begin(), workers.end(), [](const worker_data& worker){return worker.local_jobs[lane].size_approx() > 0;});
+	}
+
+	void impl_end_background()
+	{
+		background_workers_active--;
+		// we might have been the reason other workers couldn't pick up the remaining background work.
+		if(impl_background_work_queued())
+		{
+			impl_wake(1, true);
+		}
+	}
+
+	// a background job that blocks in job_wait hands its place back while it waits, otherwise whatever it's waiting on may never get a worker.
+	bool impl_suspend_background()
+	{
+		if(!holding_background)
+		{
+			return false;
+		}
+		holding_background = false;
+		impl_end_background();
+		return true;
+	}
+
+	void impl_resume_background(bool suspended)
+	{
+		if(suspended)
+		{
+			// the job is already running, so it has to carry on regardless - even if that briefly takes us over the limit.
+			background_workers_active++;
+			holding_background = true;
+		}
+	}
+
+	// bump a statistic owned by the calling worker. only the owner writes, so this doesn't need to be an atomic read-modify-write.
+	void impl_count(std::atomic<std::uint64_t>& stat, std::uint64_t amount = 1)
+	{
+		stat.store(stat.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+	}
+
+	std::uint64_t impl_now_ns()
+	{
+		return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	// move the calling worker into a new state, crediting the time spent in the old one. returns the old state.
+	worker_state impl_set_state(worker_data& me, worker_state state)
+	{
+		const worker_state old = me.state.load(std::memory_order_relaxed);
+		if(old == state)
+		{
+			return old;
+		}
+		const std::uint64_t now = impl_now_ns();
+		const std::uint64_t elapsed = now - me.state_since_ns.load(std::memory_order_relaxed);
+		const std::uint32_t sequence = me.stats_sequence.load(std::memory_order_relaxed);
+		me.stats_sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		if(old == worker_state::busy)
+		{
+			impl_count(me.busy_ns, elapsed);
+		}
+		else if(old == worker_state::parked)
+		{
+			impl_count(me.parked_ns, elapsed);
+		}
+		me.state.store(state, std::memory_order_relaxed);
+		me.state_since_ns.store(now, std::memory_order_relaxed);
+		me.stats_sequence.store(sequence + 2, std::memory_order_release);
+		return old;
+	}
+
+	job_data* impl_find_job_in_lane(worker_data* me, job_worker preferred_victim, job_priority priority)
+	{
+		const auto lane = static_cast<std::size_t>(priority);
+		job_data* job = nullptr;
+		if(me != nullptr)
+		{
+			// our own most-recently pushed work, which is likely still hot in cache.
+			job = me->local_jobs[lane].pop();
+			if(job != nullptr)
+			{
+				return job;
+			}
+		}
+		if(preferred_victim < workers.size() && &workers[preferred_victim] != me)
+		{
+			job = workers[preferred_victim].local_jobs[lane].steal();
+			if(job != nullptr)
+			{
+				if(me != nullptr)
+				{
+					impl_count(me->jobs_stolen);
+				}
+				return job;
+			}
+		}
+		if(jobs[lane].try_dequeue(job))
+		{
+			return job;
+		}
+		// nothing local. try to steal the oldest job from someone else, starting at our neighbour so thieves don't all pile onto worker 0.
+		const std::size_t first = me != nullptr ? me->my_id + 1 : 0;
+		for(std::size_t i = 0; i < workers.size(); i++)
+		{
+			worker_data& victim = workers[(first + i) % workers.size()];
+			if(&victim == me)
+			{
+				continue;
+			}
+			job = victim.local_jobs[lane].steal();
+			if(job != nullptr)
+			{
+				if(me != nullptr)
+				{
+					impl_count(me->jobs_stolen);
+				}
+				return job;
+			}
+		}
+		return nullptr;
+	}
+
+	job_data* impl_find_job(worker_data* me, job_worker preferred_victim, bool allow_background)
+	{
+		job_data* job = nullptr;
+		// affine jobs first - nobody else can do them for us.
+		if(me != nullptr && me->affine_jobs.try_dequeue(job))
+		{
+			return job;
+		}
+		if(me == nullptr && on_main_thread && main_jobs.try_dequeue(job))
+		{
+			return job;
+		}
+		// always drain the higher-priority lanes before looking at lower ones.
+		for(job_priority priority : {job_priority::realtime, job_priority::normal})
+		{
+			job = impl_find_job_in_lane(me, preferred_victim, priority);
+			if(job != nullptr)
+			{
+				return job;
+			}
+		}
+		// background work only if it isn't already occupying as many workers as it's allowed.
+		if(allow_background && impl_try_begin_background())
+		{
+			job = impl_find_job_in_lane(me, preferred_victim, job_priority::background);
+			if(job != nullptr)
+			{
+				// the slot is released by impl_run_job once the job is done.
+				return job;
+			}
+			impl_end_background();
+		}
+		return nullptr;
+	}
+
+	bool impl_work_available(const worker_data& me, bool allow_background = true)
+	{
+		if(me.affine_jobs.size_approx() > 0)
+		{
+			return true;
+		}
+		for(job_priority priority : {job_priority::realtime, job_priority::normal})
+		{
+			const auto lane = static_cast<std::size_t>(priority);
+			if(jobs[lane].size_approx() > 0 || std::any_of(workers.begin(), workers.end(), [lane](const worker_data& worker){return worker.local_jobs[lane].size_approx() > 0;}))
+			{
+				return true;
+			}
+		}
+		return allow_background && impl_background_allowed(background_workers_active.load()) && impl_background_work_queued();
+	}
+
+	// eventcount-style parking. a worker announces it's about to sleep, re-checks for work, and only then waits on its own epoch. a waker claims a specific sleeper by flipping its flag, and then bumps that worker's epoch. no locks are taken by either side, and only the claimed worker is woken.
+	// returns whether we actually went to sleep.
+	bool impl_park(worker_data& me)
+	{
+		// spin for a bit first - if work turns up soon, this saves a sleep and a wakeup (two syscalls).
+		for(std::size_t i = 0; i < me.spin_limit; i++)
+		{
+			if(requires_exit.load(std::memory_order_relaxed) || impl_work_available(me))
+			{
+				me.spin_limit = std::min(me.spin_limit * 2, job_park_spin_max);
+				return false;
+			}
+			std::this_thread::yield();
+		}
+		me.spin_limit = std::max(me.spin_limit / 2, job_park_spin_min);
+
+		const std::uint32_t epoch = me.wake_epoch.load();
+		me.sleeping.store(true);
+		sleeping_workers++;
+		// we're now visible as a sleeper, so anyone who submits after this point will wake us. re-check before actually going to sleep, otherwise a job submitted just before we got here is never picked up.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(requires_exit.load() || impl_work_available(me))
+		{
+			// take back our announcement. if someone beat us to it, they've already accounted for it - all that happens is our next park returns early.
+			if(me.sleeping.exchange(false))
+			{
+				sleeping_workers--;
+			}
+			return false;
+		}
+		impl_set_state(me, worker_state::parked);
+		// if the epoch has already moved on, this returns immediately.
+		me.wake_epoch.wait(epoch);
+		impl_set_state(me, worker_state::idle);
+		impl_count(me.wakeups);
+		return true;
+	}
+
+	// returns true if the worker was asleep and we woke it.
+	bool impl_try_wake(worker_data& worker)
+	{
+		if(worker.sleeping.load(std::memory_order_relaxed) && worker.sleeping.exchange(false))
+		{
+			sleeping_workers--;
+			worker.wake_epoch.fetch_add(1);
+			worker.wake_epoch.notify_one();
+			return true;
+		}
+		return false;
+	}
+
+	// wake up to `count` sleeping workers. if the work is background work, skip any who wouldn't take it.
+	void impl_wake(std::size_t count, bool background)
+	{
+		// pairs with the fence in impl_park. if we see no sleepers, then any worker that is about to park will see our job when it re-checks.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(count == 0 || sleeping_workers.load() == 0)
+		{
+			return;
+		}
+		const std::size_t first = wake_cursor.fetch_add(1, std::memory_order_relaxed);
+		for(std::size_t i = 0; i < workers.size() && count > 0; i++)
+		{
+			worker_data& worker = workers[(first + i) % workers.size()];
+			if(background && worker.refuses_background.load(std::memory_order_relaxed))
+			{
+				continue;
+			}
+			if(impl_try_wake(worker))
+			{
+				count--;
+			}
+		}
+	}
+
+	// wake up a specific worker, if it's asleep.
+	void impl_wake_worker(worker_data& worker)
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		impl_try_wake(worker);
+	}
+
+	void impl_wake_main()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(main_sleeping.load() && main_sleeping.exchange(false))
+		{
+			main_wake_epoch.fetch_add(1);
+			main_wake_epoch.notify_one();
+		}
+	}
+
+	// wake anyone sleeping in job_wait on `target`, which has just completed.
+	void impl_wake_waiters(const void* target)
+	{
+		impl_wake_main();
+		// pairs with the fence in impl_worker_sleep.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		for(worker_data& worker : workers)
+		{
+			if(worker.waiting_on.load() == target)
+			{
+				impl_try_wake(worker);
+			}
+		}
+	}
+
+	// the main thread can't just sleep on whatever it's waiting for, as it might be the only thread able to run a job that thing depends on. instead it sleeps on its own epoch, which is bumped when a main thread job is submitted, and whenever something it could be waiting on completes.
+	template<typename F>
+	void impl_main_sleep(F done)
+	{
+		const std::uint32_t epoch = main_wake_epoch.load();
+		main_sleeping.store(true);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(!done() && main_jobs.size_approx() == 0)
+		{
+			main_wake_epoch.wait(epoch);
+		}
+		main_sleeping.store(false);
+	}
+
+	// same goes for a worker - new work could turn up that only it can run (an affine job), or that nobody else is around to run, and the thing it's waiting on may depend on it. so it parks just like it does when idle, and can be woken by both new work and whatever it's waiting on completing.
+	template<typename F>
+	void impl_worker_sleep(worker_data& me, const void* target, bool allow_background, F done)
+	{
+		const std::uint32_t epoch = me.wake_epoch.load();
+		me.waiting_on.store(target);
+		me.refuses_background.store(!allow_background);
+		me.sleeping.store(true);
+		sleeping_workers++;
+		// pairs with the fences in impl_wake and impl_wake_waiters. either they see us as a sleeper, or we see their work/completion here.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(!done() && !impl_work_available(me, allow_background))
+		{
+			// while we're blocked, we aren't doing anything useful - even though there's a job on our stack.
+			const worker_state old = impl_set_state(me, worker_state::parked);
+			me.wake_epoch.wait(epoch);
+			impl_set_state(me, old);
+			impl_count(me.wakeups);
+		}
+		if(me.sleeping.exchange(false))
+		{
+			sleeping_workers--;
+		}
+		me.waiting_on.store(nullptr);
+		me.refuses_background.store(false);
+	}
+
+	void impl_run_job(job_data* job)
+	{
+		job->executor.store(this_worker != nullptr ? this_worker->my_id : job_worker_none, std::memory_order_relaxed);
+		// the slot is recycled once released, so remember this now.
+		const bool background = job->priority.load(std::memory_order_relaxed) == job_priority::background;
+		// impl_find_job has already counted us as running background work if that's what this is.
+		const bool outer_background = std::exchange(holding_background, background);
+		if(impl_should_drop(*job))
+		{
+			// nobody wants the result anymore. skip straight to completion, so anything waiting on the job isn't left hanging.
+			if(this_worker != nullptr)
+			{
+				impl_count(this_worker->jobs_dropped);
+			}
+		}
+		else
+		{
+			if(this_worker != nullptr)
+			{
+				impl_count(this_worker->jobs_executed);
+			}
+			job_data* outer = std::exchange(current_job, job);
+			job->fn();
+			current_job = outer;
+		}
+		impl_release_slot(*job);
+		if(background)
+		{
+			impl_end_background();
+		}
+		holding_background = outer_background;
+	}
+
+	bool impl_should_drop(const job_data& job)
+	{
+		return job.cancel.stop_requested() || (job.deadline.has_value() && std::chrono::steady_clock::now() > job.deadline.value());
+	}
+
+	#ifdef __linux__
+	std::optional<std::size_t> impl_read_sysfs_number(const std::filesystem::path& path)
+	{
+		std::ifstream file(path);
+		std::size_t ret;
+		if(file >> ret)
+		{
+			return ret;
+		}
+		return std::nullopt;
+	}
+	#endif
+
+	// detect the physical cores we're allowed to run on, sorted such that cores on the same NUMA node are next to each other.
+	std::vector<cpu_core> impl_detect_cores()
+	{
+		std::vector<cpu_core> ret;
+		#ifdef _WIN32
+		DWORD length = 0;
+		GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &length);
+		std::vector<std::byte> buffer(length);
+		if(length > 0 && GetLogicalProcessorInformationEx(RelationProcessorCore, reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data()), &length))
+		{
+			for(DWORD offset = 0; offset < length;)
+			{
+				const auto* info = reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset);
+				const GROUP_AFFINITY& mask = info->Processor.GroupMask[0];
+				cpu_core& core = ret.emplace_back();
+				core.processor_group = mask.Group;
+				for(std::size_t i = 0; i < sizeof(KAFFINITY) * 8; i++)
+				{
+					if(mask.Mask & (KAFFINITY{1} << i))
+					{
+						core.logical_processors.push_back(i);
+					}
+				}
+				PROCESSOR_NUMBER processor{.Group = mask.Group, .Number = static_cast<BYTE>(core.logical_processors.front()), .Reserved = 0};
+				USHORT node;
+				if(GetNumaProcessorNodeEx(&processor, &node))
+				{
+					core.numa_node = node;
+				}
+				offset += info->Size;
+			}
+		}
+		#elif defined(__linux__)
+		cpu_set_t allowed;
+		CPU_ZERO(&allowed);
+		if(sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+		{
+			// (numa node, package, core) -> core. a std::map keeps them sorted in that order.
+			std::map<std::tuple<std::size_t, std::size_t, std::size_t>, cpu_core> cores;
+			for(std::size_t cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			{
+				if(!CPU_ISSET(cpu, &allowed))
+				{
+					continue;
+				}
+				const std::filesystem::path dir = std::format("/sys/devices/system/cpu/cpu{}", cpu);
+				// if there's no topology info, treat every logical processor as its own core.
+				const std::size_t package = impl_read_sysfs_number(dir / "topology/physical_package_id").value_or(0);
+				const std::size_t core_id = impl_read_sysfs_number(dir / "topology/core_id").value_or(cpu);
+				std::size_t node = 0;
+				std::error_code ec;
+				for(const auto& entry : std::filesystem::directory_iterator(dir, ec))
+				{
+					const std::string name = entry.path().filename().string();
+					if(name.starts_with("node"))
+					{
+						node = std::strtoull(name.c_str() + 4, nullptr, 10);
+						break;
+					}
+				}
+				cpu_core& core = cores[{node, package, core_id}];
+				core.numa_node = node;
+				core.logical_processors.push_back(cpu);
+			}
+			for(auto& [key, core] : cores)
+			{
+				ret.push_back(std::move(core));
+			}
+		}
+		#endif
+		if(ret.empty())
+		{
+			// no idea what the topology is. assume every hardware thread is a core, but we don't know enough to pin anything.
+			ret.resize(std::max(std::thread::hardware_concurrency(), 1u));
+		}
+		return ret;
+	}
+
+	void impl_pin_current_thread(const cpu_core& core)
+	{
+		if(core.logical_processors.empty())
+		{
+			return;
+		}
+		#ifdef _WIN32
+		GROUP_AFFINITY affinity{};
+		affinity.Group = static_cast<WORD>(core.processor_group);
+		for(std::size_t i : core.logical_processors)
+		{
+			affinity.Mask |= KAFFINITY{1} << i;
+		}
+		SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr);
+		#elif defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for(std::size_t i : core.logical_processors)
+		{
+			CPU_SET(i, &set);
+		}
+		// pid 0 means the calling thread.
+		sched_setaffinity(0, sizeof(set), &set);
+		#endif
+	}
+
+	void impl_tmain(std::size_t tid)
+	{
+		worker_data& me = workers[tid];
+		this_worker = &me;
+		if(me.core.has_value())
+		{
+			impl_pin_current_thread(me.core.value());
+		}
+		bool woken = false;
+		// only look at the clock when we go from idle to busy or back, not around every single job. jobs run while another waits on them count towards the outer job's busy time, but time spent asleep inside its job_wait doesn't.
+		while(!requires_exit.load())
+		{
+			job_data* job = impl_find_job(&me);
+			if(job == nullptr)
+			{
+				impl_set_state(me, worker_state::idle);
+				if(woken)
+				{
+					// someone woke us up, but by the time we looked there was nothing for us.
+					impl_count(me.spurious_wakeups);
+				}
+				woken = impl_park(me);
+				continue;
+			}
+			woken = false;
+			impl_set_state(me, worker_state::busy);
+			impl_run_job(job);
+		}
+		impl_set_state(me, worker_state::idle);
+	}
+
+	job_handle impl_execute_job(job_function fn, std::optional<job_worker> affinity, const job_options& options)
+	{
+		job_data* data = &impl_acquire_slot();
+		data->fn = std::move(fn);
+		data->affinity = affinity;
+		data->priority.store(options.priority, std::memory_order_relaxed);
+		data->cancel = options.cancel;
+		data->deadline = options.deadline;
+		if(options.counter != nullptr)
+		{
+			detail::job_counter_access::increment(*options.counter);
+			data->counter = options.counter;
+		}
+		// careful - the job could be run and its slot recycled as soon as it's queued, so make the handle now.
+		const job_handle ret = impl_make_handle(*data);
+		impl_submit(data);
+		return ret;
+	}
+
+	void impl_submit(job_data* data)
+	{
+		if(data->affinity == job_main_thread)
+		{
+			main_jobs.enqueue(data);
+			impl_wake_main();
+		}
+		else if(data->affinity.has_value())
+		{
+			tz_assert(data->affinity.value() < workers.size(), "attempted to execute a job on worker {}, but there are only {} workers", data->affinity.value(), workers.size());
+			worker_data& worker = workers[data->affinity.value()];
+			worker.affine_jobs.enqueue(data);
+			// only one worker can take this job, so don't disturb anyone else.
+			impl_wake_worker(worker);
+		}
+		else
+		{
+			const auto lane = static_cast<std::size_t>(data->priority.load(std::memory_order_relaxed));
+			if(this_worker != nullptr)
+			{
+				// we're inside a job. push onto our own deque - we will most likely pop it ourselves before anyone gets a chance to steal it.
+				this_worker->local_jobs[lane].push(data);
+			}
+			else
+			{
+				jobs[lane].enqueue(data);
+			}
+			impl_wake(1, lane == static_cast<std::size_t>(job_priority::background));
+		}
+	}
+
+
+	namespace detail
+	{
+		void job_system_initialise(appinfo info)
+		{
+			// in case the job system is being restarted after a job_system_terminate.
+			requires_exit = false;
+			on_main_thread = true;
+			const std::vector<cpu_core> cores = impl_detect_cores();
+			// always leave at least one core for the workers.
+			const std::size_t reserved = std::min<std::size_t>(info.job_reserved_cores, cores.size() - 1);
+			const std::size_t available = cores.size() - reserved;
+			const std::size_t worker_count = info.job_workers != 0 ? info.job_workers : available;
+			for(std::size_t i = 0; i < worker_count; i++)
+			{
+				auto& worker = workers.emplace_back();
+				worker.my_id = i;
+				if(info.job_pin_workers)
+				{
+					// if there are more workers than cores, they double up.
+					worker.core = cores[reserved + (i % available)];
+				}
+			}
+			// by default, background work can use every worker but one.
+			background_worker_limit = workers.size() - 1;
+			// workers steal from each other, so don't start any of them until they all exist.
+			for(worker_data& worker : workers)
+			{
+				worker.thread = std::thread([i = worker.my_id](){impl_tmain(i);});
+			}
+		}
+
+		void job_system_terminate()
+		{
+			requires_exit = true;
+			// wake everyone up regardless of whether they look asleep. a worker part-way into parking will either see requires_exit, or have its wait cut short by the new epoch.
+			for(worker_data& worker : workers)
+			{
+				worker.wake_epoch.fetch_add(1);
+				worker.wake_epoch.notify_one();
+			}
+			for(worker_data& worker : workers)
+			{
+				worker.thread.join();
+			}
+			// anything left over was never going to run. releasing a job can queue up its dependents, so keep going until everything is empty.
+			job_data* job;
+			bool any_released;
+			do
+			{
+				any_released = false;
+				for(std::size_t lane = 0; lane < jobs.size(); lane++)
+				{
+					for(worker_data& worker : workers)
+					{
+						while((job = worker.local_jobs[lane].pop()) != nullptr || worker.affine_jobs.try_dequeue(job))
+						{
+							impl_release_slot(*job);
+							any_released = true;
+						}
+					}
+					while(jobs[lane].try_dequeue(job))
+					{
+						impl_release_slot(*job);
+						any_released = true;
+					}
+				}
+				while(main_jobs.try_dequeue(job))
+				{
+					impl_release_slot(*job);
+					any_released = true;
+				}
+			}while(any_released);
+			workers.clear();
+			std::uint32_t slot_id;
+			while(free_job_slots.try_dequeue(slot_id)){}
+			job_continuation* cont;
+			while(free_continuations.try_dequeue(cont))
+			{
+				delete cont;
+			}
+			for(std::atomic<job_data*>& chunk : job_slot_chunks)
+			{
+				delete[] chunk.exchange(nullptr);
+			}
+			job_slot_count = 0;
+			on_main_thread = false;
 		}
 	}
 
-}
\ No newline at end of file
+}
@@ -25,17 +25,13 @@ namespace tz
 
 		void lua_initialise_all_threads()
 		{
-			std::vector<tz::job_handle> jobs;
-			jobs.resize(tz::job_worker_count());
-			for(std::size_t i = 0; i < jobs.size(); i++)
+			tz::job_counter counter;
+			for(std::size_t i = 0; i < tz::job_worker_count(); i++)
 			{
-				jobs[i] = tz::job_execute_on(lua_initialise_local, i);
+				tz::job_execute_on(lua_initialise_local, i, counter);
 			}
 			lua_initialise_local();
-			for(tz::job_handle job : jobs)
-			{
-				tz::job_wait(job);
-			}
+			tz::job_wait(counter);
 		}
 	}
 
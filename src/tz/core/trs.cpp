@@ -118,5 +118,25 @@ namespace tz
 		return ret;
 	}
 
+	trs trs::inverse() const
+	{
+		trs ret;
+		// rotations are unit quaternions, so the conjugate is the inverse.
+		ret.rotate = tz::quat{tz::v4f{-this->rotate[0], -this->rotate[1], -this->rotate[2], this->rotate[3]}};
+		ret.scale = {1.0f / this->scale[0], 1.0f / this->scale[1], 1.0f / this->scale[2]};
+		ret.translate = ret.scale * ret.rotate.rotate(this->translate * -1.0f);
+		return ret;
+	}
+
+	trs trs::combine(const trs& rhs)
+	{
+		// rhs is applied first, then this - e.g parent.combine(child_local) yields the child's global transform.
+		trs ret;
+		ret.translate = this->translate + this->rotate.rotate(this->scale * rhs.translate);
+		ret.rotate = rhs.rotate.combine(this->rotate);
+		ret.scale = this->scale * rhs.scale;
+		return ret;
+	}
+
 	
 }
\ No newline at end of file
@@ -0,0 +1,437 @@
+#include "tz/os/file.hpp"
+#include "tz/topaz.hpp"
+#include "tz/detail/debug.hpp"
+#include <fstream>
+#include <vector>
+#include <mutex>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <thread>
+#include <deque>
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <cerrno>
+#endif
+
+namespace tz::os
+{
+	// state begin
+
+	#ifdef __linux__
+	struct file_read_batch;
+	// progress of a single request through the io_uring: open the file, then read until the buffer is full or we hit the end of the file, then close it.
+	struct uring_read
+	{
+		file_read_request* request;
+		file_read_batch* batch;
+		int fd = -1;
+	};
+
+	// a single call to read_files_async. completes once all of its reads have.
+	struct file_read_batch
+	{
+		std::vector<uring_read> reads;
+		tz::job_handle done = tz::nullhand;
+		std::size_t remaining = 0;
+	};
+
+	// the submission and completion rings shared with the kernel. everything here is guarded by uring_mutex.
+	struct uring
+	{
+		int fd = -1;
+		void* rings = nullptr;
+		std::size_t rings_size = 0;
+		io_uring_sqe* sqes = nullptr;
+		std::size_t sqes_size = 0;
+		unsigned* sq_head = nullptr;
+		unsigned* sq_tail = nullptr;
+		unsigned* sq_array = nullptr;
+		unsigned sq_mask = 0;
+		unsigned sq_entries = 0;
+		unsigned* cq_head = nullptr;
+		unsigned* cq_tail = nullptr;
+		io_uring_cqe* cqes = nullptr;
+		unsigned cq_mask = 0;
+		unsigned cq_entries = 0;
+		// sqes that have been queued up but not yet handed to the kernel.
+		unsigned unsubmitted = 0;
+	};
+
+	enum class uring_state
+	{
+		uninitialised,
+		running,
+		unavailable
+	};
+
+	uring ring;
+	uring_state ring_state = uring_state::uninitialised;
+	std::mutex uring_mutex;
+	// waits on completions, and submits whatever each read needs to do next.
+	std::thread io_thread;
+	bool io_requires_exit = false;
+	// number of reads with an operation in the ring. capped at the size of the completion ring, so the kernel never has more completions for us than it has space for.
+	std::size_t reads_active = 0;
+	// reads which are waiting for a space in the ring.
+	std::deque<uring_read*> reads_pending;
+	constexpr unsigned uring_entries = 256;
+	// user data of the no-op used to wake up the I/O thread. every other sqe points to its uring_read.
+	constexpr std::uint64_t uring_wake = 0;
+
+	bool impl_uring_setup();
+	void impl_uring_destroy();
+	void impl_uring_start(uring_read& read);
+	void impl_uring_submit();
+	void impl_io_main();
+	#endif
+	void impl_read_blocking(file_read_request& request);
+
+	// state end, api begin
+
+	tz::job_handle read_file_async(file_read_request& request)
+	{
+		return read_files_async({&request, 1});
+	}
+
+	tz::job_handle read_files_async(std::span<file_read_request> requests)
+	{
+		if(requests.empty())
+		{
+			return tz::nullhand;
+		}
+		for(file_read_request& request : requests)
+		{
+			request.bytes_read = 0;
+			request.status = tz::error_code::success;
+		}
+		#ifdef __linux__
+		{
+			std::unique_lock<std::mutex> lock(uring_mutex);
+			if(ring_state == uring_state::uninitialised)
+			{
+				ring_state = impl_uring_setup() ? uring_state::running : uring_state::unavailable;
+				if(ring_state == uring_state::running)
+				{
+					io_thread = std::thread(impl_io_main);
+				}
+			}
+			if(ring_state == uring_state::running)
+			{
+				auto* batch = new file_read_batch;
+				batch->reads.resize(requests.size());
+				batch->remaining = requests.size();
+				// not queued until the I/O thread releases it, once the last read is done.
+				batch->done = tz::detail::job_execute_deferred([](){});
+				const tz::job_handle ret = batch->done;
+				for(std::size_t i = 0; i < requests.size(); i++)
+				{
+					batch->reads[i] = {.request = &requests[i], .batch = batch};
+					impl_uring_start(batch->reads[i]);
+				}
+				// the whole batch goes to the kernel in one go.
+				impl_uring_submit();
+				return ret;
+			}
+		}
+		#endif
+		// no async I/O available. fall back to a regular blocking read per file on the job system.
+		std::vector<tz::job_function> fns(requests.size());
+		for(std::size_t i = 0; i < requests.size(); i++)
+		{
+			fns[i] = [request = &requests[i]](){impl_read_blocking(*request);};
+		}
+		return tz::job_execute_batch(fns, tz::job_priority::background);
+	}
+
+	// api end
+
+	void impl_read_blocking(file_read_request& request)
+	{
+		std::ifstream file(request.path, std::ios::binary);
+		if(!file.is_open())
+		{
+			request.status = tz::error_code::precondition_failure;
+			return;
+		}
+		// seeking past the end of the file means we read nothing, same as the io_uring path.
+		file.seekg(static_cast<std::streamoff>(request.offset));
+		file.read(reinterpret_cast<char*>(request.buffer.data()), static_cast<std::streamsize>(request.buffer.size()));
+		request.bytes_read = static_cast<std::size_t>(file.gcount());
+		if(file.bad())
+		{
+			request.status = tz::error_code::unknown_error;
+		}
+	}
+
+	#ifdef __linux__
+	int impl_uring_enter(unsigned to_submit, unsigned min_complete, unsigned flags)
+	{
+		return static_cast<int>(syscall(__NR_io_uring_enter, ring.fd, to_submit, min_complete, flags, nullptr, 0));
+	}
+
+	bool impl_uring_setup()
+	{
+		io_uring_params params{};
+		ring.fd = static_cast<int>(syscall(__NR_io_uring_setup, uring_entries, &params));
+		if(ring.fd < 0)
+		{
+			// no io_uring (kernel too old, or blocked by seccomp etc).
+			return false;
+		}
+		// we rely on the kernel never dropping completions, and both rings being mapped in one go (linux 5.5+).
+		if(!(params.features & IORING_FEAT_NODROP) || !(params.features & IORING_FEAT_SINGLE_MMAP))
+		{
+			close(ring.fd);
+			return false;
+		}
+		// make sure the kernel knows the operations we need (linux 5.6+).
+		constexpr std::size_t probe_ops = 256;
+		std::vector<std::byte> probe_storage(sizeof(io_uring_probe) + probe_ops * sizeof(io_uring_probe_op));
+		auto* probe = reinterpret_cast<io_uring_probe*>(probe_storage.data());
+		if(syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_PROBE, probe, probe_ops) < 0 || probe->last_op < std::max(IORING_OP_OPENAT, IORING_OP_READ) || !(probe->ops[IORING_OP_OPENAT].flags & IO_URING_OP_SUPPORTED) || !(probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED))
+		{
+			close(ring.fd);
+			return false;
+		}
+
+		ring.rings_size = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned), params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+		ring.rings = mmap(nullptr, ring.rings_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+		ring.sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+		void* sqes = mmap(nullptr, ring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+		if(ring.rings == MAP_FAILED || sqes == MAP_FAILED)
+		{
+			if(ring.rings != MAP_FAILED)
+			{
+				munmap(ring.rings, ring.rings_size);
+			}
+			if(sqes != MAP_FAILED)
+			{
+				munmap(sqes, ring.sqes_size);
+			}
+			close(ring.fd);
+			return false;
+		}
+		auto* base = static_cast<std::byte*>(ring.rings);
+		ring.sqes = static_cast<io_uring_sqe*>(sqes);
+		ring.sq_head = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+		ring.sq_tail = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+		ring.sq_array = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+		ring.sq_mask = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+		ring.sq_entries = params.sq_entries;
+		ring.cq_head = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+		ring.cq_tail = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+		ring.cqes = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+		ring.cq_mask = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+		ring.cq_entries = params.cq_entries;
+		return true;
+	}
+
+	void impl_uring_destroy()
+	{
+		munmap(ring.sqes, ring.sqes_size);
+		munmap(ring.rings, ring.rings_size);
+		close(ring.fd);
+		ring = {};
+	}
+
+	// hand everything we've queued up to the kernel. caller must hold uring_mutex.
+	void impl_uring_submit()
+	{
+		while(ring.unsubmitted > 0)
+		{
+			const int ret = impl_uring_enter(ring.unsubmitted, 0, 0);
+			if(ret < 0)
+			{
+				tz_assert(errno == EINTR || errno == EAGAIN, "io_uring_enter failed with errno {}", errno);
+				std::this_thread::yield();
+				continue;
+			}
+			ring.unsubmitted -= static_cast<unsigned>(ret);
+		}
+	}
+
+	// queue up a new operation. it isn't seen by the kernel until the next impl_uring_submit. caller must hold uring_mutex.
+	void impl_uring_push(const io_uring_sqe& sqe)
+	{
+		const unsigned tail = *ring.sq_tail;
+		if(tail - std::atomic_ref<unsigned>(*ring.sq_head).load(std::memory_order_acquire) >= ring.sq_entries)
+		{
+			// submission ring is full. without SQPOLL, the kernel consumes every sqe we submit straight away, so this frees up the whole ring.
+			impl_uring_submit();
+		}
+		const unsigned index = tail & ring.sq_mask;
+		ring.sqes[index] = sqe;
+		ring.sq_array[index] = index;
+		std::atomic_ref<unsigned>(*ring.sq_tail).store(tail + 1, std::memory_order_release);
+		ring.unsubmitted++;
+	}
+
+	void impl_uring_read_next(uring_read& read)
+	{
+		file_read_request& request = *read.request;
+		io_uring_sqe sqe{};
+		sqe.opcode = IORING_OP_READ;
+		sqe.fd = read.fd;
+		sqe.addr = reinterpret_cast<std::uint64_t>(request.buffer.data() + request.bytes_read);
+		// a single read is capped at just under 2GiB anyway.
+		sqe.len = static_cast<unsigned>(std::min<std::size_t>(request.buffer.size() - request.bytes_read, std::numeric_limits<int>::max()));
+		sqe.off = request.offset + request.bytes_read;
+		sqe.user_data = reinterpret_cast<std::uint64_t>(&read);
+		impl_uring_push(sqe);
+	}
+
+	// caller must hold uring_mutex.
+	void impl_uring_start(uring_read& read)
+	{
+		if(reads_active >= ring.cq_entries)
+		{
+			reads_pending.push_back(&read);
+			return;
+		}
+		reads_active++;
+		io_uring_sqe sqe{};
+		sqe.opcode = IORING_OP_OPENAT;
+		sqe.fd = AT_FDCWD;
+		sqe.addr = reinterpret_cast<std::uint64_t>(read.request->path.c_str());
+		sqe.open_flags = O_RDONLY | O_CLOEXEC;
+		sqe.user_data = reinterpret_cast<std::uint64_t>(&read);
+		impl_uring_push(sqe);
+	}
+
+	// caller must hold uring_mutex.
+	void impl_uring_finish(uring_read& read)
+	{
+		if(read.fd >= 0)
+		{
+			close(read.fd);
+		}
+		reads_active--;
+		if(!reads_pending.empty())
+		{
+			impl_uring_start(*reads_pending.front());
+			reads_pending.pop_front();
+		}
+		file_read_batch* batch = read.batch;
+		if(--batch->remaining == 0)
+		{
+			tz::detail::job_release_deferred(batch->done);
+			delete batch;
+		}
+	}
+
+	// caller must hold uring_mutex.
+	void impl_uring_complete(uring_read& read, int result)
+	{
+		file_read_request& request = *read.request;
+		if(result == -EINTR || result == -EAGAIN)
+		{
+			// try the same thing again.
+			if(read.fd < 0)
+			{
+				reads_active--;
+				impl_uring_start(read);
+			}
+			else
+			{
+				impl_uring_read_next(read);
+			}
+			return;
+		}
+		if(read.fd < 0)
+		{
+			// file has just been opened.
+			if(result < 0)
+			{
+				request.status = tz::error_code::precondition_failure;
+				impl_uring_finish(read);
+				return;
+			}
+			read.fd = result;
+		}
+		else if(result < 0)
+		{
+			request.status = tz::error_code::unknown_error;
+			impl_uring_finish(read);
+			return;
+		}
+		else
+		{
+			request.bytes_read += static_cast<std::size_t>(result);
+			if(result == 0)
+			{
+				// end of file.
+				impl_uring_finish(read);
+				return;
+			}
+		}
+		if(request.bytes_read < request.buffer.size())
+		{
+			impl_uring_read_next(read);
+		}
+		else
+		{
+			impl_uring_finish(read);
+		}
+	}
+
+	void impl_io_main()
+	{
+		while(true)
+		{
+			// sleep until at least one completion turns up.
+			impl_uring_enter(0, 1, IORING_ENTER_GETEVENTS);
+			std::unique_lock<std::mutex> lock(uring_mutex);
+			unsigned head = *ring.cq_head;
+			const unsigned tail = std::atomic_ref<unsigned>(*ring.cq_tail).load(std::memory_order_acquire);
+			for(; head != tail; head++)
+			{
+				const io_uring_cqe& cqe = ring.cqes[head & ring.cq_mask];
+				if(cqe.user_data != uring_wake)
+				{
+					impl_uring_complete(*reinterpret_cast<uring_read*>(cqe.user_data), cqe.res);
+				}
+			}
+			std::atomic_ref<unsigned>(*ring.cq_head).store(head, std::memory_order_release);
+			// every read that needs to do something else has queued it up. submit them all at once.
+			impl_uring_submit();
+			if(io_requires_exit && reads_active == 0 && reads_pending.empty())
+			{
+				return;
+			}
+		}
+	}
+	#endif
+}
+
+namespace tz::detail
+{
+	void file_io_terminate()
+	{
+		#ifdef __linux__
+		std::unique_lock<std::mutex> lock(tz::os::uring_mutex);
+		if(tz::os::ring_state == tz::os::uring_state::running)
+		{
+			// let any reads still in progress finish, and then wake up the I/O thread so it notices it needs to stop.
+			tz::os::io_requires_exit = true;
+			io_uring_sqe wake{};
+			wake.opcode = IORING_OP_NOP;
+			wake.user_data = tz::os::uring_wake;
+			tz::os::impl_uring_push(wake);
+			tz::os::impl_uring_submit();
+			lock.unlock();
+			tz::os::io_thread.join();
+			lock.lock();
+			tz::os::impl_uring_destroy();
+		}
+		tz::os::ring_state = tz::os::uring_state::uninitialised;
+		tz::os::io_requires_exit = false;
+		#endif
+	}
+}
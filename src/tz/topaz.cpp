@@ -4,7 +4,7 @@ namespace tz
 {
 	void initialise(appinfo info)
 	{
-		detail::job_system_initialise();
+		detail::job_system_initialise(info);
 		detail::lua_initialise_all_threads();
 		os::initialise(info);
 		gpu::initialise(info);
@@ -14,6 +14,7 @@ namespace tz
 	{
 		gpu::terminate();
 		os::terminate();
+		detail::file_io_terminate();
 		detail::job_system_terminate();
 	}
 }
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include "tz/topaz.hpp"
+#include "tz/os/file.hpp"
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <format>
+#include <cstring>
+
+const std::filesystem::path dir = std::filesystem::temp_directory_path() / "tz_file_async_test";
+
+std::string file_contents(std::size_t i)
+{
+	// every file is a different size, with different contents.
+	std::string ret;
+	for(std::size_t j = 0; j <= i % 64; j++)
+	{
+		ret += std::format("file {} line {}\n", i, j);
+	}
+	return ret;
+}
+
+std::filesystem::path make_file(std::size_t i)
+{
+	const std::filesystem::path path = dir / std::format("{}.txt", i);
+	std::ofstream(path, std::ios::binary) << file_contents(i);
+	return path;
+}
+
+bool buffer_equals(std::span<const std::byte> buffer, std::string_view expected)
+{
+	return buffer.size() >= expected.size() && std::memcmp(buffer.data(), expected.data(), expected.size()) == 0;
+}
+
+void test_read_many_files()
+{
+	// more files than fit in the ring at once.
+	constexpr std::size_t file_count = 1500;
+	std::vector<std::vector<std::byte>> buffers(file_count);
+	std::vector<tz::os::file_read_request> requests(file_count);
+	for(std::size_t i = 0; i < file_count; i++)
+	{
+		requests[i].path = make_file(i);
+		buffers[i].resize(std::filesystem::file_size(requests[i].path));
+		requests[i].buffer = buffers[i];
+	}
+	tz::job_wait(tz::os::read_files_async(requests));
+	for(std::size_t i = 0; i < file_count; i++)
+	{
+		const std::string expected = file_contents(i);
+		tz_assert(requests[i].status == tz::error_code::success, "reading file {} failed: {}", i, tz::error_code_name(requests[i].status));
+		tz_assert(requests[i].bytes_read == expected.size(), "read wrong number of bytes from file {}. Expected {}, got {}", i, expected.size(), requests[i].bytes_read);
+		tz_assert(buffer_equals(buffers[i], expected), "file {} contents were wrong", i);
+	}
+}
+
+void test_missing_file()
+{
+	// a missing file doesn't stop the rest of the batch.
+	std::vector<std::byte> good_buffer(file_contents(7).size());
+	std::vector<std::byte> bad_buffer(16);
+	std::array<tz::os::file_read_request, 2> requests
+	{
+		tz::os::file_read_request{.path = dir / "does_not_exist.txt", .buffer = bad_buffer},
+		tz::os::file_read_request{.path = make_file(7), .buffer = good_buffer}
+	};
+	tz::job_wait(tz::os::read_files_async(requests));
+	tz_assert(requests[0].status == tz::error_code::precondition_failure, "reading a missing file should fail with a precondition failure, but got: {}", tz::error_code_name(requests[0].status));
+	tz_assert(requests[0].bytes_read == 0, "read {} bytes from a file that doesn't exist", requests[0].bytes_read);
+	tz_assert(requests[1].status == tz::error_code::success, "reading file failed: {}", tz::error_code_name(requests[1].status));
+	tz_assert(buffer_equals(good_buffer, file_contents(7)), "file contents were wrong");
+}
+
+void test_partial_reads()
+{
+	const std::string contents = file_contents(63);
+	const std::filesystem::path path = make_file(63);
+
+	// buffer smaller than the file: stop once it's full.
+	std::vector<std::byte> small(10);
+	tz::os::file_read_request req{.path = path, .buffer = small, .offset = 5};
+	tz::job_wait(tz::os::read_file_async(req));
+	tz_assert(req.status == tz::error_code::success && req.bytes_read == small.size(), "partial read failed. Expected {} bytes, got {}", small.size(), req.bytes_read);
+	tz_assert(buffer_equals(small, std::string_view{contents}.substr(5, 10)), "partial read at an offset read the wrong bytes");
+
+	// buffer bigger than the file: stop at the end of the file.
+	std::vector<std::byte> big(contents.size() * 2);
+	req = {.path = path, .buffer = big};
+	tz::job_wait(tz::os::read_file_async(req));
+	tz_assert(req.status == tz::error_code::success && req.bytes_read == contents.size(), "read past the end of the file. Expected {} bytes, got {}", contents.size(), req.bytes_read);
+	tz_assert(buffer_equals(big, contents), "file contents were wrong");
+
+	// offset past the end of the file: nothing to read.
+	req = {.path = path, .buffer = small, .offset = contents.size() + 100};
+	tz::job_wait(tz::os::read_file_async(req));
+	tz_assert(req.status == tz::error_code::success && req.bytes_read == 0, "read {} bytes from past the end of the file", req.bytes_read);
+
+	tz_assert(tz::os::read_files_async({}) == tz::nullhand, "an empty batch of reads should return a null handle");
+}
+
+#include "tz/main.hpp"
+int tz_main()
+{
+	tz::initialise();
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir);
+	test_read_many_files();
+	test_missing_file();
+	test_partial_reads();
+	std::filesystem::remove_all(dir);
+	tz::terminate();
+	return 0;
+}
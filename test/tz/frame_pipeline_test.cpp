@@ -0,0 +1,152 @@
+#include "tz/topaz.hpp"
+#include "tz/core/frame_pipeline.hpp"
+#include <atomic>
+#include <thread>
+#include <array>
+#include <vector>
+
+constexpr std::size_t frame_count = 200;
+constexpr std::size_t phase_count = static_cast<std::size_t>(tz::frame_phase::_count);
+
+// every phase start/end takes a ticket, so we can check the order things happened in afterwards.
+std::atomic<std::uint64_t> ticket = 0;
+struct phase_record
+{
+	std::uint64_t begin = 0;
+	std::uint64_t end = 0;
+};
+
+struct render_data
+{
+	std::uint64_t frame = 0;
+	std::vector<int> draws = {};
+};
+
+void test_frame_ordering(std::size_t max_frames_in_flight)
+{
+	std::vector<std::array<phase_record, phase_count>> records(frame_count);
+	std::atomic<bool> bad_render_data = false;
+	{
+		tz::frame_pipeline<render_data> pipeline{max_frames_in_flight};
+		tz_assert(pipeline.max_frames_in_flight() == max_frames_in_flight, "frame pipeline reports wrong max frames in flight. Expected {}, got {}", max_frames_in_flight, pipeline.max_frames_in_flight());
+		auto record = [&records](tz::frame_phase phase, auto&& fn)
+		{
+			return [&records, phase, fn](tz::frame_context<render_data>& frame)
+			{
+				phase_record& rec = records[frame.index][static_cast<std::size_t>(phase)];
+				rec.begin = ++ticket;
+				fn(frame);
+				rec.end = ++ticket;
+			};
+		};
+		pipeline.set_phase(tz::frame_phase::input, record(tz::frame_phase::input, [](auto&){}));
+		pipeline.set_phase(tz::frame_phase::simulate, record(tz::frame_phase::simulate, [](auto&)
+		{
+			volatile int work = 0;
+			for(int i = 0; i < 1000; i++){work = work + i;}
+		}));
+		pipeline.set_phase(tz::frame_phase::prepare_render, record(tz::frame_phase::prepare_render, [](tz::frame_context<render_data>& frame)
+		{
+			frame.render_data.frame = frame.index;
+			frame.render_data.draws.assign(static_cast<std::size_t>(frame.index % 16), static_cast<int>(frame.index));
+		}));
+		pipeline.set_phase(tz::frame_phase::submit, record(tz::frame_phase::submit, [&bad_render_data](tz::frame_context<render_data>& frame)
+		{
+			// if another frame's prepare_render touched our render data in the meantime, we'd see it here.
+			bool ok = frame.render_data.frame == frame.index && frame.render_data.draws.size() == frame.index % 16;
+			for(int draw : frame.render_data.draws)
+			{
+				ok &= draw == static_cast<int>(frame.index);
+			}
+			if(!ok)
+			{
+				bad_render_data = true;
+			}
+		}));
+		for(std::size_t i = 0; i < frame_count; i++)
+		{
+			pipeline.run_frame();
+		}
+		// destructor waits for every frame to finish.
+	}
+	tz_assert(!bad_render_data, "submit phase saw render data that wasn't written by its own frame (max frames in flight {})", max_frames_in_flight);
+
+	auto at = [&records](std::size_t frame, tz::frame_phase phase) -> const phase_record&{return records[frame][static_cast<std::size_t>(phase)];};
+	for(std::size_t i = 0; i < frame_count; i++)
+	{
+		for(std::size_t p = 0; p < phase_count; p++)
+		{
+			tz_assert(records[i][p].end != 0, "phase {} of frame {} never ran", p, i);
+			if(p > 0)
+			{
+				tz_assert(records[i][p].begin > records[i][p - 1].end, "phase {} of frame {} started before the previous phase finished", p, i);
+			}
+			if(i > 0)
+			{
+				tz_assert(records[i][p].begin > records[i - 1][p].end, "phase {} of frame {} started before the same phase of the previous frame finished", p, i);
+			}
+		}
+		if(i > 0)
+		{
+			tz_assert(at(i, tz::frame_phase::simulate).begin > at(i - 1, tz::frame_phase::prepare_render).end, "frame {} started simulating while the previous frame was still preparing to render", i);
+			tz_assert(at(i, tz::frame_phase::input).begin > at(i - 1, tz::frame_phase::simulate).end, "frame {} gathered input while the previous frame was still simulating", i);
+		}
+		if(i >= max_frames_in_flight)
+		{
+			tz_assert(at(i, tz::frame_phase::input).begin > at(i - max_frames_in_flight, tz::frame_phase::submit).end, "frame {} began while more than {} frames were in flight", i, max_frames_in_flight);
+		}
+	}
+}
+
+void test_submit_on_main_thread()
+{
+	// submit usually calls tz::gpu::execute, which may only be called from the main thread.
+	const std::thread::id main_thread = std::this_thread::get_id();
+	std::atomic<std::size_t> wrong_thread = 0;
+	std::atomic<std::size_t> submits = 0;
+	{
+		tz::frame_pipeline<int> pipeline;
+		pipeline.set_phase(tz::frame_phase::submit, [&](auto&)
+		{
+			submits++;
+			if(std::this_thread::get_id() != main_thread)
+			{
+				wrong_thread++;
+			}
+		});
+		for(std::size_t i = 0; i < 32; i++)
+		{
+			pipeline.run_frame();
+		}
+	}
+	tz_assert(submits == 32, "wrong number of frames submitted. Expected {}, got {}", 32, submits.load());
+	tz_assert(wrong_thread == 0, "{} submit phases ran on a thread other than the main thread", wrong_thread.load());
+}
+
+void test_empty_phases()
+{
+	// phases with no function are fine, and frames still complete.
+	tz::frame_pipeline<int> pipeline;
+	std::atomic<std::size_t> submits = 0;
+	pipeline.set_phase(tz::frame_phase::submit, [&submits](auto&){submits++;});
+	tz::job_handle last = tz::nullhand;
+	for(std::size_t i = 0; i < 10; i++)
+	{
+		last = pipeline.run_frame();
+	}
+	tz::job_wait(last);
+	tz_assert(submits == 10, "wrong number of frames submitted. Expected {}, got {}", 10, submits.load());
+}
+
+#include "tz/main.hpp"
+int tz_main()
+{
+	tz::initialise();
+	test_frame_ordering(1);
+	test_frame_ordering(2);
+	test_frame_ordering(3);
+	test_submit_on_main_thread();
+	test_empty_phases();
+	tz::terminate();
+	return 0;
+}
@@ -0,0 +1,292 @@
+#include "tz/topaz.hpp"
+#include "tz/core/hier.hpp"
+#include <vector>
+#include <map>
+#include <span>
+#include <cstdlib>
+
+// parent of each node, keyed by the node's handle value.
+using parent_map = std::map<std::uint64_t, tz::node_handle>;
+
+// global transform computed the slow way, walking all the way up to the root.
+tz::trs expected_global(tz::hier_handle hier, const parent_map& parents, tz::node_handle node)
+{
+	tz::trs parent_global = {};
+	const tz::node_handle parent = parents.at(node.peek());
+	if(parent != tz::nullhand)
+	{
+		parent_global = expected_global(hier, parents, parent);
+	}
+	return parent_global.combine(tz_must(tz::hier_node_get_local_transform(hier, node)));
+}
+
+tz::trs random_trs()
+{
+	auto rnd = [](){return static_cast<float>(std::rand() % 200) / 100.0f - 1.0f;};
+	return
+	{
+		.translate = {rnd(), rnd(), rnd()},
+		.rotate = tz::quat::from_axis_angle({0.0f, 1.0f, 0.0f}, rnd()),
+		.scale = tz::v3f::filled(1.0f + rnd() * 0.5f)
+	};
+}
+
+void test_global_transform_cache()
+{
+	tz::hier_handle hier = tz::create_hier();
+	std::vector<tz::node_handle> nodes;
+	parent_map parents;
+	// a random tree, where each node's parent was created before it.
+	for(std::size_t i = 0; i < 256; i++)
+	{
+		const tz::node_handle parent = i == 0 ? tz::nullhand : nodes[std::rand() % i];
+		nodes.push_back(tz_must(tz::hier_create_node(hier, random_trs(), parent)));
+		parents[nodes.back().peek()] = parent;
+	}
+	auto check_all = [&]()
+	{
+		for(tz::node_handle node : nodes)
+		{
+			tz_assert(tz_must(tz::hier_node_get_global_transform(hier, node)) == expected_global(hier, parents, node), "cached global transform of node {} is out of date", node.peek());
+		}
+	};
+	check_all();
+	// moving a node must invalidate the cache of everything beneath it.
+	for(std::size_t i = 0; i < 64; i++)
+	{
+		tz::hier_node_set_local_transform(hier, nodes[std::rand() % nodes.size()], random_trs());
+		if(i % 8 == 0)
+		{
+			check_all();
+		}
+	}
+	check_all();
+	tz::destroy_hier(hier);
+}
+
+void test_set_global_transform()
+{
+	tz::hier_handle hier = tz::create_hier();
+	tz::node_handle root = tz_must(tz::hier_create_node(hier, {.translate = {1.0f, 2.0f, 3.0f}, .scale = tz::v3f::filled(2.0f)}));
+	tz::node_handle child = tz_must(tz::hier_create_node(hier, {}, root));
+	tz::node_handle grandchild = tz_must(tz::hier_create_node(hier, {.translate = {1.0f, 0.0f, 0.0f}}, child));
+	tz::hier_node_set_global_transform(hier, child, {.translate = {5.0f, 5.0f, 5.0f}, .scale = tz::v3f::filled(2.0f)});
+	const tz::trs child_global = tz_must(tz::hier_node_get_global_transform(hier, child));
+	tz_assert((child_global.translate - tz::v3f{5.0f, 5.0f, 5.0f}).length() < 0.001f, "set global transform placed the node in the wrong position");
+	// the grandchild moves along with its parent.
+	const tz::trs grandchild_global = tz_must(tz::hier_node_get_global_transform(hier, grandchild));
+	tz_assert((grandchild_global.translate - tz::v3f{7.0f, 5.0f, 5.0f}).length() < 0.001f, "child did not move along with its parent");
+	tz::destroy_hier(hier);
+}
+
+void test_destroy_node()
+{
+	tz::hier_handle hier = tz::create_hier();
+	tz::node_handle root = tz_must(tz::hier_create_node(hier));
+	tz::node_handle child = tz_must(tz::hier_create_node(hier, {}, root));
+	tz::node_handle grandchild = tz_must(tz::hier_create_node(hier, {}, child));
+	tz_assert(tz::hier_destroy_node(hier, child) == tz::error_code::success, "failed to destroy node");
+	// children are destroyed along with their parent.
+	tz_assert(!tz::hier_node_get_global_transform(hier, grandchild).has_value(), "child of a destroyed node is still alive");
+	// reuse the destroyed slots. the root must not still think of them as its children.
+	tz::node_handle other = tz_must(tz::hier_create_node(hier, {.translate = {1.0f, 0.0f, 0.0f}}));
+	tz::hier_node_set_local_transform(hier, root, {.translate = {0.0f, 1.0f, 0.0f}});
+	tz_assert(tz_must(tz::hier_node_get_global_transform(hier, other)).translate == tz::v3f(1.0f, 0.0f, 0.0f), "moving a node affected an unrelated node");
+	tz::destroy_hier(hier);
+}
+
+// after compaction, nodes must be stored tightly-packed in depth-first order.
+void check_depth_first(tz::hier_handle hier, const std::vector<tz::node_handle>& nodes, const parent_map& parents)
+{
+	std::vector<tz::node_handle> by_index(nodes.size(), tz::nullhand);
+	for(tz::node_handle node : nodes)
+	{
+		const std::size_t index = tz::hier_node_index(hier, node);
+		tz_assert(index < nodes.size() && by_index[index] == tz::nullhand, "compacted hierarchy has a hole or duplicate at index {}", index);
+		by_index[index] = node;
+	}
+	// each node is followed by its first child, or else the next sibling of it or one of its ancestors.
+	for(std::size_t i = 1; i < by_index.size(); i++)
+	{
+		const tz::node_handle parent = parents.at(by_index[i].peek());
+		bool ok = parent == tz::nullhand;
+		for(tz::node_handle prev = by_index[i - 1]; !ok && prev != tz::nullhand; prev = parents.at(prev.peek()))
+		{
+			ok = prev == parent;
+		}
+		tz_assert(ok, "nodes are not stored in depth-first order (node at index {})", i);
+	}
+}
+
+void test_update()
+{
+	tz::hier_handle hier = tz::create_hier();
+	std::vector<tz::node_handle> nodes;
+	parent_map parents;
+	// big enough that it gets split across multiple jobs.
+	for(std::size_t i = 0; i < 4096; i++)
+	{
+		const tz::node_handle parent = i < 4 ? tz::nullhand : nodes[std::rand() % i];
+		nodes.push_back(tz_must(tz::hier_create_node(hier, random_trs(), parent)));
+		parents[nodes.back().peek()] = parent;
+	}
+	auto check_all = [&](std::span<const tz::trs> globals)
+	{
+		// destroyed nodes may leave holes.
+		tz_assert(globals.size() >= nodes.size(), "hier_update returned {} transforms, expected at least {}", globals.size(), nodes.size());
+		for(tz::node_handle node : nodes)
+		{
+			tz_assert(globals[tz::hier_node_index(hier, node)] == expected_global(hier, parents, node), "hier_update calculated the wrong global transform for node {}", node.peek());
+		}
+	};
+	check_all(tz::hier_update(hier));
+	for(std::size_t i = 0; i < 256; i++)
+	{
+		tz::hier_node_set_local_transform(hier, nodes[std::rand() % nodes.size()], random_trs());
+	}
+	check_all(tz::hier_update(hier));
+	// nothing changed, so nothing to do.
+	check_all(tz::hier_update(hier));
+
+	// destroying a subtree leaves everything else where it was.
+	const std::size_t index = tz::hier_node_index(hier, nodes[200]);
+	tz_assert(tz::hier_destroy_node(hier, nodes[100]) == tz::error_code::success, "failed to destroy node");
+	if(tz::hier_node_get_local_transform(hier, nodes[200]).has_value())
+	{
+		tz_assert(tz::hier_node_index(hier, nodes[200]) == index, "destroying a node moved an unrelated node from index {} to {}", index, tz::hier_node_index(hier, nodes[200]));
+	}
+	std::erase_if(nodes, [hier](tz::node_handle node){return !tz::hier_node_get_local_transform(hier, node).has_value();});
+	tz::hier_node_set_local_transform(hier, nodes[0], random_trs());
+	check_all(tz::hier_update(hier));
+
+	// lots of churn, with the hierarchy changing shape all over the place.
+	for(std::size_t i = 0; i < 2048; i++)
+	{
+		if(std::rand() % 3 == 0)
+		{
+			tz_assert(tz::hier_destroy_node(hier, nodes[std::rand() % nodes.size()]) == tz::error_code::success, "failed to destroy node");
+			std::erase_if(nodes, [hier](tz::node_handle node){return !tz::hier_node_get_local_transform(hier, node).has_value();});
+		}
+		if(nodes.empty() || std::rand() % 8 == 0)
+		{
+			nodes.push_back(tz_must(tz::hier_create_node(hier, random_trs())));
+			parents[nodes.back().peek()] = tz::nullhand;
+		}
+		else
+		{
+			const tz::node_handle parent = nodes[std::rand() % nodes.size()];
+			nodes.push_back(tz_must(tz::hier_create_node(hier, random_trs(), parent)));
+			parents[nodes.back().peek()] = parent;
+		}
+		if(i % 256 == 0)
+		{
+			check_all(tz::hier_update(hier));
+		}
+		if(i % 512 == 0)
+		{
+			tz::hier_compact(hier);
+			check_depth_first(hier, nodes, parents);
+		}
+	}
+	check_all(tz::hier_update(hier));
+	tz::hier_compact(hier);
+	check_depth_first(hier, nodes, parents);
+	check_all(tz::hier_update(hier));
+	tz::destroy_hier(hier);
+}
+
+void test_stale_handles()
+{
+	tz::hier_handle hier = tz::create_hier();
+	tz::node_handle root = tz_must(tz::hier_create_node(hier));
+	tz::node_handle old = tz_must(tz::hier_create_node(hier, {.translate = {1.0f, 0.0f, 0.0f}}, root));
+	tz_assert(tz::hier_destroy_node(hier, old) == tz::error_code::success, "failed to destroy node");
+	tz_assert(tz::hier_destroy_node(hier, old) == tz::error_code::invalid_value, "double destroy of a node was not detected");
+	// takes the destroyed node's place.
+	tz::node_handle replacement = tz_must(tz::hier_create_node(hier, {.translate = {0.0f, 2.0f, 0.0f}}, root));
+	tz_assert(replacement != old, "new node was given the same handle as a destroyed node");
+	tz_assert(!tz::hier_node_get_local_transform(hier, old).has_value(), "stale node handle was accepted");
+	tz_assert(!tz::hier_create_node(hier, {}, old).has_value(), "created a node whose parent is a stale node handle");
+	tz_assert(tz::hier_destroy_node(hier, old) == tz::error_code::invalid_value, "destroying a stale node handle destroyed its replacement");
+	tz_assert(tz_must(tz::hier_node_get_local_transform(hier, replacement)).translate == tz::v3f(0.0f, 2.0f, 0.0f), "replacement node was affected by its stale predecessor");
+	tz_assert(!tz::hier_node_get_global_transform(hier, tz::nullhand).has_value(), "null node handle was accepted");
+
+	// heavy churn - validation doesn't depend on how many nodes have been destroyed.
+	std::vector<tz::node_handle> stale;
+	for(std::size_t i = 0; i < 10000; i++)
+	{
+		tz::node_handle node = tz_must(tz::hier_create_node(hier, {}, root));
+		tz_assert(tz::hier_destroy_node(hier, node) == tz::error_code::success, "failed to destroy node");
+		if(i % 100 == 0)
+		{
+			stale.push_back(node);
+		}
+	}
+	for(tz::node_handle node : stale)
+	{
+		tz_assert(!tz::hier_node_get_global_transform(hier, node).has_value(), "stale node handle was accepted");
+	}
+	tz_assert(tz_must(tz::hier_node_get_global_transform(hier, replacement)).translate == tz::v3f(0.0f, 2.0f, 0.0f), "replacement node was affected by churn");
+	tz::destroy_hier(hier);
+}
+
+void test_compact()
+{
+	tz::hier_handle hier = tz::create_hier();
+	std::vector<tz::node_handle> nodes;
+	parent_map parents;
+	for(std::size_t i = 0; i < 1024; i++)
+	{
+		const tz::node_handle parent = i < 2 ? tz::nullhand : nodes[std::rand() % i];
+		nodes.push_back(tz_must(tz::hier_create_node(hier, random_trs(), parent)));
+		parents[nodes.back().peek()] = parent;
+	}
+	// destroy most of it, including everything created last.
+	std::vector<tz::node_handle> stale;
+	for(std::size_t i = nodes.size() - 1; i >= 16; i--)
+	{
+		if(tz::hier_node_get_local_transform(hier, nodes[i]).has_value())
+		{
+			tz_assert(tz::hier_destroy_node(hier, nodes[i]) == tz::error_code::success, "failed to destroy node");
+		}
+		stale.push_back(nodes[i]);
+	}
+	std::erase_if(nodes, [hier](tz::node_handle node){return !tz::hier_node_get_local_transform(hier, node).has_value();});
+	tz::hier_compact(hier);
+	check_depth_first(hier, nodes, parents);
+	// surviving handles still work, stale ones are still stale.
+	std::span<const tz::trs> globals = tz::hier_update(hier);
+	tz_assert(globals.size() == nodes.size(), "hier_update returned {} transforms after compaction, expected {}", globals.size(), nodes.size());
+	for(tz::node_handle node : nodes)
+	{
+		tz_assert(globals[tz::hier_node_index(hier, node)] == expected_global(hier, parents, node), "wrong global transform for node {} after compaction", node.peek());
+	}
+	// the slots of the stale handles will get reused now, but they mustn't come back to life.
+	for(std::size_t i = 0; i < 1024; i++)
+	{
+		tz_must(tz::hier_create_node(hier, {}, nodes[i % nodes.size()]));
+	}
+	for(tz::node_handle node : stale)
+	{
+		tz_assert(!tz::hier_node_get_local_transform(hier, node).has_value(), "stale node handle {} was accepted after compaction", node.peek());
+	}
+	for(tz::node_handle node : nodes)
+	{
+		tz_assert(tz_must(tz::hier_node_get_global_transform(hier, node)) == expected_global(hier, parents, node), "wrong global transform for node {} after compaction", node.peek());
+	}
+	tz::destroy_hier(hier);
+}
+
+#include "tz/main.hpp"
+int tz_main()
+{
+	tz::initialise();
+	test_global_transform_cache();
+	test_set_global_transform();
+	test_destroy_node();
+	test_update();
+	test_stale_handles();
+	test_compact();
+	tz::terminate();
+	return 0;
+}
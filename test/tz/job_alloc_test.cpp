@@ -0,0 +1,106 @@
+#include "tz/topaz.hpp"
+#include "tz/core/job.hpp"
+#include <atomic>
+#include <array>
+#include <cstdlib>
+#include <new>
+#include <memory_resource>
+#include <vector>
+
+// count every heap allocation made by anyone in the process.
+std::atomic<std::size_t> allocation_count = 0;
+
+void* operator new(std::size_t size)
+{
+	allocation_count++;
+	if(void* ptr = std::malloc(size == 0 ? 1 : size))
+	{
+		return ptr;
+	}
+	throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+constexpr std::size_t job_count = 1024;
+std::array<tz::job_handle, job_count> handles;
+std::atomic<std::size_t> sum = 0;
+
+void submit_and_wait()
+{
+	for(std::size_t i = 0; i < job_count; i++)
+	{
+		// 48 bytes of captures - far beyond what std::function stores inline on any implementation.
+		std::array<std::size_t, 6> payload{i, 1, 2, 3, 4, 5};
+		handles[i] = tz::job_execute([payload](){sum += payload[0] + payload[5];});
+	}
+	for(tz::job_handle job : handles)
+	{
+		tz::job_wait(job);
+	}
+}
+
+void submit_and_wait_scratch()
+{
+	tz::job_counter counter;
+	for(std::size_t i = 0; i < job_count; i++)
+	{
+		// spread evenly across the workers, so that each worker's scratch usage is the same every frame. otherwise one unlucky worker could run more jobs than it ever has before, and its arena would have to grow.
+		tz::job_execute_on([i]()
+		{
+			// temporaries within a job come from the worker's scratch arena, not the heap.
+			std::pmr::vector<std::size_t> temp{tz::job_scratch()};
+			for(std::size_t j = 0; j < 256; j++)
+			{
+				temp.push_back(i + j);
+			}
+			sum += temp.back();
+		}, i % tz::job_worker_count(), counter);
+	}
+	tz::job_wait(counter);
+	tz::job_scratch_reset();
+}
+
+#include "tz/main.hpp"
+int tz_main()
+{
+	tz::initialise();
+	// warm up: the first time round, the job system is allowed to allocate its slots and queue storage. make sure every worker has run something, too.
+	for(std::size_t i = 0; i < tz::job_worker_count(); i++)
+	{
+		tz::job_wait(tz::job_execute_on([](){}, i));
+	}
+	for(std::size_t i = 0; i < 4; i++)
+	{
+		submit_and_wait();
+	}
+
+	// steady state: no allocations at all.
+	sum = 0;
+	allocation_count = 0;
+	submit_and_wait();
+	std::size_t allocs = allocation_count.load();
+	tz_assert(sum == (job_count * (job_count - 1)) / 2 + job_count * 5, "jobs produced wrong result");
+	tz_assert(allocs == 0, "steady-state job submission performed {} heap allocations, expected none", allocs);
+
+	// same again, but with each job using scratch memory, and a reset at the end of each 'frame'.
+	for(std::size_t i = 0; i < 4; i++)
+	{
+		submit_and_wait_scratch();
+	}
+	allocation_count = 0;
+	submit_and_wait_scratch();
+	allocs = allocation_count.load();
+	tz_assert(allocs == 0, "steady-state jobs using scratch memory performed {} heap allocations, expected none", allocs);
+
+	tz::terminate();
+	return 0;
+}
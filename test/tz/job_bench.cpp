@@ -0,0 +1,342 @@
+#include "tz/topaz.hpp"
+#include "tz/core/job.hpp"
+#include <atomic>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <format>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+// job system benchmarks. prints a single JSON object to stdout, e.g `tz_job_bench > job_bench.json`, so results can be tracked across releases.
+// every benchmark is run a few times, and the median run is reported.
+
+using bench_clock = std::chrono::steady_clock;
+constexpr std::size_t bench_repeats = 5;
+std::vector<std::string> results;
+
+double elapsed_ms(bench_clock::time_point begin)
+{
+	return std::chrono::duration<double, std::milli>(bench_clock::now() - begin).count();
+}
+
+template<typename F>
+double median_ms(F&& run)
+{
+	std::array<double, bench_repeats> times;
+	for(double& time : times)
+	{
+		time = run();
+	}
+	std::sort(times.begin(), times.end());
+	return times[bench_repeats / 2];
+}
+
+void bench_empty_jobs()
+{
+	constexpr std::size_t job_count = 100000;
+	const double individual = median_ms([]()
+	{
+		tz::job_counter counter;
+		auto begin = bench_clock::now();
+		for(std::size_t i = 0; i < job_count; i++)
+		{
+			tz::job_execute([](){}, counter);
+		}
+		tz::job_wait(counter);
+		return elapsed_ms(begin);
+	});
+	std::vector<tz::job_function> fns(job_count);
+	const double batched = median_ms([&fns]()
+	{
+		for(tz::job_function& fn : fns)
+		{
+			fn = [](){};
+		}
+		auto begin = bench_clock::now();
+		tz::job_wait(tz::job_execute_batch(fns));
+		return elapsed_ms(begin);
+	});
+	results.push_back(std::format(R"({{"name": "empty_job_throughput", "jobs": {}, "individual_ms": {:.3f}, "individual_jobs_per_second": {:.0f}, "batched_ms": {:.3f}, "batched_jobs_per_second": {:.0f}}})", job_count, individual, job_count / (individual / 1000.0), batched, job_count / (batched / 1000.0)));
+}
+
+void bench_latency()
+{
+	// time from just before job_execute to the job starting to run on a worker. submitted from a non-worker thread, one at a time, so this includes waking a worker if they are all asleep.
+	// poll rather than job_wait, otherwise we'd just run the job ourselves.
+	constexpr std::size_t sample_count = 10000;
+	std::vector<double> samples(sample_count);
+	for(std::size_t i = 0; i < sample_count; i++)
+	{
+		std::atomic<bench_clock::time_point> started;
+		auto submitted = bench_clock::now();
+		tz::job_handle job = tz::job_execute([&started](){started = bench_clock::now();});
+		while(!tz::job_complete(job))
+		{
+			std::this_thread::yield();
+		}
+		samples[i] = std::chrono::duration<double, std::micro>(started.load() - submitted).count();
+	}
+	std::sort(samples.begin(), samples.end());
+	auto percentile = [&samples](double p){return samples[std::min(static_cast<std::size_t>(p * samples.size()), samples.size() - 1)];};
+	results.push_back(std::format(R"({{"name": "submit_to_start_latency", "samples": {}, "p50_us": {:.3f}, "p90_us": {:.3f}, "p99_us": {:.3f}, "max_us": {:.3f}}})", sample_count, percentile(0.5), percentile(0.9), percentile(0.99), samples.back()));
+}
+
+void bench_parallel_for()
+{
+	// some arithmetic per element, so that there's real work to spread out.
+	constexpr std::size_t element_count = 1 << 22;
+	std::vector<float> data(element_count);
+	auto work = [&data](std::size_t i){data[i] = std::sqrt(static_cast<float>(i)) * 0.5f + std::sin(static_cast<float>(i));};
+	const double serial = median_ms([&work]()
+	{
+		auto begin = bench_clock::now();
+		for(std::size_t i = 0; i < element_count; i++)
+		{
+			work(i);
+		}
+		return elapsed_ms(begin);
+	});
+	std::string grains;
+	for(std::size_t grain : {std::size_t{0}, std::size_t{256}, std::size_t{4096}, std::size_t{65536}})
+	{
+		const double parallel = median_ms([&work, grain]()
+		{
+			auto begin = bench_clock::now();
+			tz::job_parallel_for(0, element_count, grain, work);
+			return elapsed_ms(begin);
+		});
+		const double speedup = serial / parallel;
+		grains += std::format(R"({}{{"grain": {}, "ms": {:.3f}, "speedup": {:.3f}, "efficiency": {:.3f}}})", grains.empty() ? "" : ", ", grain, parallel, speedup, speedup / tz::job_worker_count());
+	}
+	results.push_back(std::format(R"({{"name": "parallel_for_scaling", "elements": {}, "serial_ms": {:.3f}, "runs": [{}]}})", element_count, serial, grains));
+}
+
+std::atomic<std::size_t> spawn_leaves = 0;
+void spawn_tree(int depth)
+{
+	if(depth == 0)
+	{
+		spawn_leaves++;
+		return;
+	}
+	// each level spawns one child as a job and recurses into the other itself, then waits - the worst case for job_wait nesting.
+	tz::job_handle left = tz::job_execute([depth](){spawn_tree(depth - 1);});
+	spawn_tree(depth - 1);
+	tz::job_wait(left);
+}
+
+void bench_recursive_spawn()
+{
+	constexpr int depth = 16;
+	const double time = median_ms([]()
+	{
+		spawn_leaves = 0;
+		auto begin = bench_clock::now();
+		tz::job_wait(tz::job_execute([](){spawn_tree(depth);}));
+		return elapsed_ms(begin);
+	});
+	const std::size_t job_count = std::size_t{1} << depth;
+	results.push_back(std::format(R"({{"name": "recursive_spawn", "depth": {}, "jobs": {}, "ms": {:.3f}, "jobs_per_second": {:.0f}}})", depth, job_count, time, job_count / (time / 1000.0)));
+}
+
+void bench_affine_round_trip()
+{
+	constexpr std::size_t round_trips = 1000;
+	const double time = median_ms([]()
+	{
+		auto begin = bench_clock::now();
+		for(std::size_t i = 0; i < round_trips; i++)
+		{
+			tz::job_wait(tz::job_execute_on([](){}, i % tz::job_worker_count()));
+		}
+		return elapsed_ms(begin);
+	});
+	results.push_back(std::format(R"({{"name": "affine_round_trip", "round_trips": {}, "ms": {:.3f}, "mean_us": {:.3f}}})", round_trips, time, time * 1000.0 / round_trips));
+}
+
+// the scheduler topaz used before work-stealing, kept here as a baseline to compare against. every job goes through one global queue that workers take from under a single mutex, every submission wakes every sleeping worker, and waiting means sleeping in 10us steps until the work is done (the waiting thread never helps).
+// this keeps the old design's queueing and wake-up costs, but not its bookkeeping of job ids (a list searched and erased from on every dequeue), so if anything it flatters the baseline.
+class baseline_scheduler
+{
+public:
+	baseline_scheduler(std::size_t thread_count)
+	{
+		for(std::size_t i = 0; i < thread_count; i++)
+		{
+			this->threads.emplace_back([this](){this->tmain();});
+		}
+	}
+
+	~baseline_scheduler()
+	{
+		{
+			std::unique_lock<std::mutex> lock(this->wake_mutex);
+			this->requires_exit = true;
+		}
+		this->wake_condition.notify_all();
+		for(std::thread& thread : this->threads)
+		{
+			thread.join();
+		}
+	}
+
+	void execute(tz::job_function fn, std::atomic<std::size_t>& counter)
+	{
+		counter++;
+		{
+			std::unique_lock<std::mutex> lock(this->wake_mutex);
+			this->jobs.push_back({.fn = std::move(fn), .counter = &counter});
+		}
+		this->wake_condition.notify_all();
+	}
+
+	void wait(const std::atomic<std::size_t>& counter)
+	{
+		while(counter.load() != 0)
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(10));
+		}
+	}
+private:
+	struct job
+	{
+		tz::job_function fn;
+		std::atomic<std::size_t>* counter;
+	};
+
+	void tmain()
+	{
+		while(true)
+		{
+			job next;
+			{
+				std::unique_lock<std::mutex> lock(this->wake_mutex);
+				this->wake_condition.wait(lock, [this](){return this->requires_exit || !this->jobs.empty();});
+				if(this->requires_exit)
+				{
+					return;
+				}
+				next = std::move(this->jobs.front());
+				this->jobs.pop_front();
+			}
+			next.fn();
+			next.counter->fetch_sub(1);
+		}
+	}
+
+	std::vector<std::thread> threads;
+	std::deque<job> jobs;
+	bool requires_exit = false;
+	std::mutex wake_mutex;
+	std::condition_variable wake_condition;
+};
+
+float small_job_work(std::size_t seed)
+{
+	float acc = 0.0f;
+	for(std::size_t i = 0; i < 2000; i++)
+	{
+		acc += std::sqrt(static_cast<float>(seed + i)) * std::sin(static_cast<float>(i));
+	}
+	return acc;
+}
+
+void bench_scheduler_comparison(tz::appinfo info)
+{
+	// the same flat workloads through the baseline scheduler and through the job system, restarted with each worker count in turn. flat because the baseline can't run nested work: a worker waiting on a child just sleeps, and with few enough threads never wakes up.
+	constexpr std::size_t empty_job_count = 100000;
+	constexpr std::size_t small_job_count = 10000;
+	std::vector<float> sink(small_job_count);
+	std::string runs;
+	for(unsigned int thread_count : {1u, 4u, 16u, 64u})
+	{
+		double baseline_empty, baseline_small;
+		{
+			baseline_scheduler baseline{thread_count};
+			baseline_empty = median_ms([&baseline]()
+			{
+				std::atomic<std::size_t> counter = 0;
+				auto begin = bench_clock::now();
+				for(std::size_t i = 0; i < empty_job_count; i++)
+				{
+					baseline.execute([](){}, counter);
+				}
+				baseline.wait(counter);
+				return elapsed_ms(begin);
+			});
+			baseline_small = median_ms([&baseline, &sink]()
+			{
+				std::atomic<std::size_t> counter = 0;
+				auto begin = bench_clock::now();
+				for(std::size_t i = 0; i < small_job_count; i++)
+				{
+					baseline.execute([&sink, i](){sink[i] = small_job_work(i);}, counter);
+				}
+				baseline.wait(counter);
+				return elapsed_ms(begin);
+			});
+		}
+
+		tz::detail::job_system_terminate();
+		tz::appinfo restart = info;
+		restart.job_workers = thread_count;
+		tz::detail::job_system_initialise(restart);
+		const double tz_empty = median_ms([]()
+		{
+			tz::job_counter counter;
+			auto begin = bench_clock::now();
+			for(std::size_t i = 0; i < empty_job_count; i++)
+			{
+				tz::job_execute([](){}, counter);
+			}
+			tz::job_wait(counter);
+			return elapsed_ms(begin);
+		});
+		const double tz_small = median_ms([&sink]()
+		{
+			tz::job_counter counter;
+			auto begin = bench_clock::now();
+			for(std::size_t i = 0; i < small_job_count; i++)
+			{
+				tz::job_execute([&sink, i](){sink[i] = small_job_work(i);}, counter);
+			}
+			tz::job_wait(counter);
+			return elapsed_ms(begin);
+		});
+		runs += std::format(R"({}{{"threads": {}, "empty_jobs": {{"baseline_ms": {:.3f}, "tz_ms": {:.3f}, "speedup": {:.3f}}}, "small_jobs": {{"baseline_ms": {:.3f}, "tz_ms": {:.3f}, "speedup": {:.3f}}}}})", runs.empty() ? "" : ", ", thread_count, baseline_empty, tz_empty, baseline_empty / tz_empty, baseline_small, tz_small, baseline_small / tz_small);
+	}
+	// put things back how they were.
+	tz::detail::job_system_terminate();
+	tz::detail::job_system_initialise(info);
+	results.push_back(std::format(R"({{"name": "scheduler_comparison", "empty_jobs": {}, "small_jobs": {}, "runs": [{}]}})", empty_job_count, small_job_count, runs));
+}
+
+#include "tz/main.hpp"
+int tz_main()
+{
+	const tz::appinfo info{.name = "tz_job_bench"};
+	tz::initialise(info);
+	bench_empty_jobs();
+	bench_latency();
+	bench_parallel_for();
+	bench_recursive_spawn();
+	bench_affine_round_trip();
+	bench_scheduler_comparison(info);
+
+	std::string json = std::format(R"({{"benchmark": "tz_job_bench", "workers": {}, "results": [)", tz::job_worker_count());
+	for(std::size_t i = 0; i < results.size(); i++)
+	{
+		json += std::format("{}\n\t{}", i == 0 ? "" : ",", results[i]);
+	}
+	json += "\n]}\n";
+	std::fputs(json.c_str(), stdout);
+	tz::terminate();
+	return 0;
+}
@@ -0,0 +1,37 @@
+#include "tz/topaz.hpp"
+#include "tz/core/job.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "tz/main.hpp"
+int tz_main()
+{
+	// more workers than this machine may well have cores, pinned. they should double up rather than fail.
+	tz::initialise
+	({
+		.name = "tz_job_config_test",
+		.job_workers = 3,
+		.job_reserved_cores = 0,
+		.job_pin_workers = true
+	});
+	tz_assert(tz::job_worker_count() == 3, "requested {} job workers, but got {}", 3, tz::job_worker_count());
+
+	std::vector<tz::job_handle> jobs;
+	std::vector<std::thread::id> ids(tz::job_worker_count());
+	for(std::size_t i = 0; i < tz::job_worker_count(); i++)
+	{
+		jobs.push_back(tz::job_execute_on([&ids, i](){ids[i] = std::this_thread::get_id();}, i));
+	}
+	std::atomic<std::size_t> count = 0;
+	tz::job_parallel_for(0, 10000, 0, [&count](std::size_t){count++;});
+	for(tz::job_handle job : jobs)
+	{
+		tz::job_wait(job);
+	}
+	tz_assert(count == 10000, "pinned workers ran {} iterations of a parallel for, expected {}", count.load(), 10000);
+	tz_assert(ids[0] != ids[1] && ids[1] != ids[2] && ids[0] != ids[2], "pinned workers are not distinct threads");
+
+	tz::terminate();
+	return 0;
+}
@@ -0,0 +1,712 @@
+#include "tz/topaz.hpp"
+#include "tz/core/job.hpp"
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <array>
+#include <mutex>
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <functional>
+#include <string>
+#include <cstdint>
+#include <memory_resource>
+
+void test_execute_wait()
+{
+	std::atomic<int> value = 0;
+	tz::job_handle job = tz::job_execute([&value](){value = 5;});
+	tz::job_wait(job);
+	tz_assert(tz::job_complete(job), "job_complete returned false after job_wait");
+	tz_assert(value == 5, "job did not run before job_wait returned. Expected {}, got {}", 5, value.load());
+}
+
+void test_handle_reuse()
+{
+	// once a job is done, its handle must stay complete even after whatever it referred to internally is reused by newer jobs.
+	tz::job_handle old_job = tz::job_execute([](){});
+	tz::job_wait(old_job);
+	std::atomic<bool> release = false;
+	std::vector<tz::job_handle> jobs;
+	for(std::size_t i = 0; i < 64; i++)
+	{
+		jobs.push_back(tz::job_execute([&release](){while(!release.load()){std::this_thread::yield();}}));
+	}
+	tz_assert(tz::job_complete(old_job), "completed job handle was reported incomplete after new jobs were submitted");
+	tz_assert(tz::job_complete(tz::nullhand), "null job handle should always be complete");
+	release = true;
+	for(tz::job_handle job : jobs)
+	{
+		tz::job_wait(job);
+	}
+}
+
+void test_many_jobs()
+{
+	constexpr int job_count = 4096;
+	std::atomic<int> value = 0;
+	std::vector<tz::job_handle> jobs;
+	for(int i = 0; i < job_count; i++)
+	{
+		jobs.push_back(tz::job_execute([&value](){value++;}));
+	}
+	for(tz::job_handle job : jobs)
+	{
+		tz::job_wait(job);
+	}
+	tz_assert(value == job_count, "expected {} jobs to have run, but only {} did", job_count, value.load());
+}
+
+std::atomic<int> nested_value = 0;
+constexpr int nested_width = 8;
+constexpr int nested_depth = 4;
+void nested_spawn(int level)
+{
+	// each job spawns more jobs from within a worker, which go onto that worker's local deque and get stolen by everyone else.
+	if(level + 1 < nested_depth)
+	{
+		for(int i = 0; i < nested_width; i++)
+		{
+			tz::job_execute([level](){nested_spawn(level + 1);});
+		}
+	}
+	nested_value++;
+}
+
+void test_nested_spawn()
+{
+	constexpr int expected = 8 + 8*8 + 8*8*8 + 8*8*8*8;
+	for(int i = 0; i < nested_width; i++)
+	{
+		tz::job_execute([](){nested_spawn(0);});
+	}
+	while(nested_value.load() != expected)
+	{
+		std::this_thread::yield();
+	}
+}
+
+int nested_fib(int n)
+{
+	// every level blocks on its children from inside a job. with fewer workers than levels, this only works if job_wait helps run them.
+	if(n < 2)
+	{
+		return n;
+	}
+	int a, b;
+	tz::job_handle job = tz::job_execute([&a, n](){a = nested_fib(n - 1);});
+	b = nested_fib(n - 2);
+	tz::job_wait(job);
+	return a + b;
+}
+
+void test_nested_wait()
+{
+	int result = 0;
+	tz::job_wait(tz::job_execute([&result](){result = nested_fib(16);}));
+	tz_assert(result == 987, "nested fib(16) produced wrong result. Expected {}, got {}", 987, result);
+}
+
+void test_parallel_for()
+{
+	constexpr std::size_t count = 1'000'000;
+	std::vector<std::size_t> values(count, 0);
+	tz::job_parallel_for(0, count, 0, [&values](std::size_t i){values[i] += i * 2;});
+	for(std::size_t i = 0; i < count; i++)
+	{
+		tz_assert(values[i] == i * 2, "parallel_for wrote wrong value at index {}. Expected {}, got {}", i, i * 2, values[i]);
+	}
+
+	// odd range boundaries and a grain that doesn't divide them.
+	std::vector<std::atomic<int>> visits(1000);
+	tz::job_handle job = tz::job_execute_range(13, 987, 7, [&visits](std::size_t i){visits[i]++;});
+	tz::job_wait(job);
+	for(std::size_t i = 0; i < visits.size(); i++)
+	{
+		int expected = (i >= 13 && i < 987) ? 1 : 0;
+		tz_assert(visits[i] == expected, "execute_range visited index {} {} times, expected {}", i, visits[i].load(), expected);
+	}
+}
+
+void test_execute_after()
+{
+	// c runs after both a and b, and must see both of their writes.
+	std::atomic<bool> release = false;
+	int a_val = 0, b_val = 0, c_val = 0;
+	// a must run on a worker. if job_wait(b) below helped out by running it on this thread, it would spin forever.
+	tz::job_handle a = tz::job_execute_on([&](){while(!release.load()){std::this_thread::yield();} a_val = 1;}, 0);
+	tz::job_handle b = tz::job_execute([&](){b_val = 2;});
+	std::array<tz::job_handle, 2> deps{a, b};
+	tz::job_handle c = tz::job_execute_after([&](){c_val = a_val + b_val;}, deps);
+	tz::job_wait(b);
+	tz_assert(!tz::job_complete(c), "job_execute_after job completed before one of its dependencies");
+	release = true;
+	tz::job_wait(c);
+	tz_assert(c_val == 3, "job_execute_after job ran before its dependencies finished. Expected {}, got {}", 3, c_val);
+
+	// dependencies that are already complete should be ignored.
+	tz::job_wait(tz::job_execute_after([](){}, deps));
+}
+
+void test_job_graph()
+{
+	// diamond: update -> (animation, culling) -> upload
+	std::vector<int> order;
+	std::mutex order_mutex;
+	auto record = [&](int id){return [&order, &order_mutex, id](){std::unique_lock<std::mutex> lock(order_mutex); order.push_back(id);};};
+	tz::job_graph_handle graph = tz::create_job_graph();
+	tz::job_graph_node update = tz::job_graph_add(graph, record(0));
+	std::array<tz::job_graph_node, 1> after_update{update};
+	tz::job_graph_node animation = tz::job_graph_add(graph, record(1), after_update);
+	tz::job_graph_node culling = tz::job_graph_add(graph, record(1), after_update);
+	std::array<tz::job_graph_node, 2> after_both{animation, culling};
+	tz::job_graph_add(graph, record(2), after_both);
+	// resubmit a few times, as we would every frame.
+	for(int frame = 0; frame < 8; frame++)
+	{
+		order.clear();
+		tz::job_wait(tz::job_graph_execute(graph));
+		tz_assert(order.size() == 4, "job graph execution ran {} nodes, expected {}", order.size(), 4);
+		tz_assert(std::is_sorted(order.begin(), order.end()), "job graph nodes ran out of dependency order on frame {}", frame);
+	}
+	tz::destroy_job_graph(graph);
+}
+
+void test_priorities()
+{
+	// job_execute(fn, {}) must not quietly mean realtime.
+	static_assert(tz::job_priority{} == tz::job_priority::normal);
+	// saturate the background lane with jobs that won't finish until we say so. more urgent work must still get through.
+	const std::size_t old_limit = tz::job_background_worker_limit();
+	tz::job_set_background_worker_limit(1);
+	std::atomic<bool> release = false;
+	std::atomic<int> running = 0;
+	std::atomic<int> max_running = 0;
+	std::vector<tz::job_handle> background_jobs;
+	for(std::size_t i = 0; i < tz::job_worker_count() * 2; i++)
+	{
+		background_jobs.push_back(tz::job_execute([&]()
+		{
+			int now = ++running;
+			int prev = max_running.load();
+			while(prev < now && !max_running.compare_exchange_weak(prev, now));
+			while(!release.load())
+			{
+				std::this_thread::yield();
+			}
+			running--;
+		}, tz::job_priority::background));
+	}
+	std::atomic<int> value = 0;
+	tz::job_wait(tz::job_execute([&value](){value = 1;}, tz::job_priority::realtime));
+	tz::job_wait(tz::job_execute([&value](){value++;}));
+	tz_assert(value == 2, "realtime/normal jobs did not run while background lane was saturated. Expected {}, got {}", 2, value.load());
+	release = true;
+	for(tz::job_handle job : background_jobs)
+	{
+		tz::job_wait(job);
+	}
+	tz_assert(max_running <= 1, "background worker limit of 1 was exceeded - {} background jobs ran at once", max_running.load());
+	tz::job_set_background_worker_limit(old_limit);
+}
+
+void test_background_nested_wait()
+{
+	// more background jobs than there are workers, each of them waiting on background work of its own. a background job that's blocked mustn't keep its place in the background lane, otherwise nothing gets to run the children.
+	std::atomic<std::size_t> children = 0;
+	std::vector<tz::job_handle> parents;
+	for(std::size_t i = 0; i < tz::job_worker_count() * 2; i++)
+	{
+		parents.push_back(tz::job_execute([&children]()
+		{
+			tz::job_wait(tz::job_execute([&children](){children++;}, tz::job_priority::background));
+			tz::job_counter counter;
+			tz::job_execute([&children](){children++;}, counter, tz::job_priority::background);
+			tz::job_wait(counter);
+		}, tz::job_priority::background));
+	}
+	for(tz::job_handle parent : parents)
+	{
+		tz::job_wait(parent);
+	}
+	tz_assert(children == parents.size() * 2, "background children did not all run. Expected {}, got {}", parents.size() * 2, children.load());
+}
+
+void test_nested_parallel_for_priority()
+{
+	if(tz::job_worker_count() < 2)
+	{
+		return;
+	}
+	// a realtime job's parallel_for must be picked up by other workers ahead of a backlog of normal jobs, rather than queueing behind them.
+	std::atomic<bool> release = false;
+	std::vector<tz::job_handle> backlog;
+	for(std::size_t i = 0; i < tz::job_worker_count() * 64; i++)
+	{
+		backlog.push_back(tz::job_execute([&release]()
+		{
+			if(!release.load())
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			}
+		}));
+	}
+	std::mutex ids_mutex;
+	std::vector<std::thread::id> ids;
+	tz::job_wait(tz::job_execute([&ids, &ids_mutex]()
+	{
+		tz::job_parallel_for(0, 64, 1, [&ids, &ids_mutex](std::size_t)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			std::unique_lock<std::mutex> lock(ids_mutex);
+			if(std::find(ids.begin(), ids.end(), std::this_thread::get_id()) == ids.end())
+			{
+				ids.push_back(std::this_thread::get_id());
+			}
+		});
+	}, tz::job_priority::realtime));
+	release = true;
+	for(tz::job_handle job : backlog)
+	{
+		tz::job_wait(job);
+	}
+	tz_assert(ids.size() > 1, "parallel_for within a realtime job only ran on {} thread(s), its work must have been queued behind normal jobs", ids.size());
+}
+
+void test_affine_jobs()
+{
+	std::vector<tz::job_handle> jobs;
+	std::vector<std::thread::id> ids(tz::job_worker_count());
+	for(std::size_t i = 0; i < tz::job_worker_count(); i++)
+	{
+		jobs.push_back(tz::job_execute_on([&ids, i](){ids[i] = std::this_thread::get_id();}, i));
+	}
+	for(tz::job_handle job : jobs)
+	{
+		tz::job_wait(job);
+	}
+	for(std::size_t i = 0; i < ids.size(); i++)
+	{
+		for(std::size_t j = i + 1; j < ids.size(); j++)
+		{
+			tz_assert(ids[i] != ids[j], "affine jobs for workers {} and {} ran on the same thread", i, j);
+		}
+	}
+}
+
+void test_wait_runs_affine_work()
+{
+	if(tz::job_worker_count() < 2)
+	{
+		return;
+	}
+	// worker 0 goes to sleep waiting on a job running on worker 1, which then needs a job that only worker 0 can run. worker 0 must wake up and run it.
+	std::atomic<bool> ran = false;
+	auto needs_worker_0 = [&ran]()
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		tz::job_wait(tz::job_execute_on([&ran](){ran = true;}, 0));
+	};
+	tz::job_wait(tz::job_execute_on([&needs_worker_0]()
+	{
+		tz::job_wait(tz::job_execute_on(needs_worker_0, 1));
+	}, 0));
+	tz_assert(ran, "affine job did not run");
+	ran = false;
+	tz::job_wait(tz::job_execute_on([&needs_worker_0]()
+	{
+		tz::job_counter counter;
+		tz::job_execute_on(needs_worker_0, 1, counter);
+		tz::job_wait(counter);
+	}, 0));
+	tz_assert(ran, "affine job did not run");
+}
+
+void test_main_thread_jobs()
+{
+	const std::thread::id main_id = std::this_thread::get_id();
+	// a worker job which waits on a main thread job. waiting on it from the main thread must run the inner job, even though the main thread has nothing to do with the outer one.
+	std::atomic<std::thread::id> inner_id;
+	tz::job_wait(tz::job_execute([&inner_id]()
+	{
+		tz::job_wait(tz::job_execute_on([&inner_id](){inner_id = std::this_thread::get_id();}, tz::job_main_thread));
+	}));
+	tz_assert(inner_id.load() == main_id, "main thread job ran on some other thread");
+
+	// nobody runs main thread jobs until the main thread asks.
+	constexpr std::size_t job_count = 16;
+	std::atomic<std::size_t> ran = 0;
+	std::atomic<bool> wrong_thread = false;
+	std::vector<tz::job_handle> jobs;
+	for(std::size_t i = 0; i < job_count; i++)
+	{
+		jobs.push_back(tz::job_execute_on([&ran, &wrong_thread, main_id]()
+		{
+			if(std::this_thread::get_id() != main_id)
+			{
+				wrong_thread = true;
+			}
+			ran++;
+		}, tz::job_main_thread));
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	tz_assert(ran == 0, "main thread jobs ran before the main thread pumped them");
+	// a budget of zero still runs a single job, as it is only checked in between jobs.
+	tz_assert(tz::job_pump_main(std::chrono::nanoseconds::zero()) == 1, "job_pump_main overran its budget");
+	tz_assert(ran == 1, "wrong number of main thread jobs ran. Expected {}, got {}", 1, ran.load());
+	tz_assert(tz::job_pump_main() >= job_count - 1, "job_pump_main didn't run every main thread job");
+	tz_assert(ran == job_count, "wrong number of main thread jobs ran. Expected {}, got {}", job_count, ran.load());
+	tz_assert(!wrong_thread, "main thread job ran on some other thread");
+	for(tz::job_handle job : jobs)
+	{
+		tz_assert(tz::job_complete(job), "main thread job was run, but isn't complete");
+	}
+	// same again, but waiting on a counter - submitted from a worker, so the main thread could already be asleep by the time they turn up.
+	tz::job_counter counter;
+	ran = 0;
+	tz::job_execute([&counter, &ran]()
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		for(std::size_t i = 0; i < job_count; i++)
+		{
+			tz::job_execute_on([&ran](){ran++;}, tz::job_main_thread, counter);
+		}
+	}, counter);
+	tz::job_wait(counter);
+	tz_assert(ran == job_count, "wrong number of main thread jobs ran. Expected {}, got {}", job_count, ran.load());
+}
+
+void test_execute_batch()
+{
+	constexpr std::size_t batch_size = 10000;
+	std::vector<int> results(batch_size, 0);
+	std::vector<tz::job_function> fns;
+	for(std::size_t i = 0; i < batch_size; i++)
+	{
+		fns.push_back([&results, i](){results[i] = static_cast<int>(i);});
+	}
+	tz::job_handle batch = tz::job_execute_batch(fns);
+	// anything that depends on the batch must see all of its results.
+	std::array<tz::job_handle, 1> deps{batch};
+	std::atomic<bool> saw_all = false;
+	tz::job_handle after = tz::job_execute_after([&](){saw_all = std::all_of(results.begin(), results.end(), [i = 0](int r)mutable{return r == i++;});}, deps);
+	tz::job_wait(batch);
+	for(std::size_t i = 0; i < batch_size; i++)
+	{
+		tz_assert(results[i] == static_cast<int>(i), "batch job {} did not run", i);
+	}
+	tz::job_wait(after);
+	tz_assert(saw_all, "job depending on a batch ran before the whole batch completed");
+
+	// batches submitted from within a job go to that worker's deque instead.
+	std::atomic<std::size_t> count = 0;
+	tz::job_wait(tz::job_execute([&count]()
+	{
+		std::vector<tz::job_function> inner;
+		for(std::size_t i = 0; i < 1000; i++)
+		{
+			inner.push_back([&count](){count++;});
+		}
+		tz::job_wait(tz::job_execute_batch(inner));
+	}));
+	tz_assert(count == 1000, "nested batch ran {} jobs, expected {}", count.load(), 1000);
+	tz_assert(tz::job_execute_batch({}) == tz::nullhand, "empty batch should return a null handle");
+}
+
+void test_stats()
+{
+	std::vector<tz::job_worker_stats> before;
+	for(std::size_t i = 0; i < tz::job_worker_count(); i++)
+	{
+		before.push_back(tz::job_stats(i));
+	}
+	// let everyone go idle and park, so that the jobs below have to wake them up.
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	// affine jobs can only be run by their worker, so every worker's counters must move.
+	std::vector<tz::job_handle> jobs;
+	for(std::size_t i = 0; i < tz::job_worker_count(); i++)
+	{
+		jobs.push_back(tz::job_execute_on([](){std::this_thread::sleep_for(std::chrono::milliseconds(2));}, i));
+	}
+	for(tz::job_handle job : jobs)
+	{
+		tz::job_wait(job);
+	}
+	std::chrono::nanoseconds total_parked = std::chrono::nanoseconds::zero();
+	for(std::size_t i = 0; i < tz::job_worker_count(); i++)
+	{
+		tz::job_worker_stats after = tz::job_stats(i);
+		tz_assert(after.jobs_executed > before[i].jobs_executed, "worker {} ran an affine job, but its executed count did not increase", i);
+		tz_assert(after.busy_time - before[i].busy_time >= std::chrono::milliseconds(2), "worker {} ran a 2ms job, but its busy time only increased by {}ns", i, (after.busy_time - before[i].busy_time).count());
+		total_parked += after.parked_time;
+		tz_assert(after.spurious_wakeups <= after.wakeups, "worker {} has more spurious wakeups ({}) than wakeups ({})", i, after.spurious_wakeups, after.wakeups);
+		tz_assert(after.affine_queue_depth == 0, "worker {} still has {} affine jobs queued after they all completed", i, after.affine_queue_depth);
+	}
+	tz_assert(total_parked > std::chrono::nanoseconds::zero(), "no worker has ever parked");
+
+	// time spent in a state the worker is still in must show up straight away, not only once the worker leaves it. otherwise a worker that's busy (or asleep) for a whole frame looks like it did nothing.
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	const tz::job_worker_stats asleep = tz::job_stats(0);
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	const tz::job_worker_stats still_asleep = tz::job_stats(0);
+	tz_assert(still_asleep.parked_time - asleep.parked_time >= std::chrono::milliseconds(10), "worker 0 is still parked, but its parked time only increased by {}ns", (still_asleep.parked_time - asleep.parked_time).count());
+	std::atomic<bool> running = false;
+	std::atomic<bool> release = false;
+	tz::job_handle long_job = tz::job_execute_on([&running, &release]()
+	{
+		running = true;
+		while(!release.load())
+		{
+			std::this_thread::yield();
+		}
+	}, 0);
+	while(!running.load())
+	{
+		std::this_thread::yield();
+	}
+	const tz::job_worker_stats busy = tz::job_stats(0);
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	const tz::job_worker_stats still_busy = tz::job_stats(0);
+	release = true;
+	tz::job_wait(long_job);
+	tz_assert(still_busy.busy_time - busy.busy_time >= std::chrono::milliseconds(10), "worker 0 is still running a job, but its busy time only increased by {}ns", (still_busy.busy_time - busy.busy_time).count());
+}
+
+std::atomic<std::size_t> counter_leaves = 0;
+void counter_fan_out(tz::job_counter& counter, int depth)
+{
+	if(depth == 0)
+	{
+		counter_leaves++;
+		return;
+	}
+	// children are added to the same counter before their parent completes, so it can never reach zero early.
+	for(int i = 0; i < 4; i++)
+	{
+		tz::job_execute([&counter, depth](){counter_fan_out(counter, depth - 1);}, counter);
+	}
+}
+
+void test_counter()
+{
+	tz::job_counter counter;
+	tz_assert(counter.value() == 0, "new job counter has value {}, expected 0", counter.value());
+	// waiting on an unused counter returns immediately.
+	tz::job_wait(counter);
+
+	std::vector<int> results(1000, 0);
+	for(std::size_t i = 0; i < results.size(); i++)
+	{
+		tz::job_execute([&results, i](){results[i] = 1;}, counter);
+	}
+	tz::job_wait(counter);
+	tz_assert(counter.value() == 0, "job counter has value {} after waiting on it, expected 0", counter.value());
+	tz_assert(std::all_of(results.begin(), results.end(), [](int r){return r == 1;}), "job_wait on a counter returned before all of its jobs completed");
+
+	// reuse the same counter for recursive fan-out, waited on from within a job.
+	counter_leaves = 0;
+	tz::job_wait(tz::job_execute([&counter](){counter_fan_out(counter, 5); tz::job_wait(counter);}));
+	tz_assert(counter_leaves == 1024, "recursive fan-out on a counter reached {} leaves, expected {}", counter_leaves.load(), 1024);
+
+	// affine jobs on every worker.
+	std::atomic<std::size_t> affine_count = 0;
+	for(std::size_t i = 0; i < tz::job_worker_count(); i++)
+	{
+		tz::job_execute_on([&affine_count](){affine_count++;}, i, counter);
+	}
+	tz::job_wait(counter);
+	tz_assert(affine_count == tz::job_worker_count(), "{} affine jobs completed before job_wait on their counter returned, expected {}", affine_count.load(), tz::job_worker_count());
+}
+
+void test_cancellation()
+{
+	// a job cancelled before it starts never runs, but still completes as far as everyone else is concerned.
+	std::stop_source source;
+	std::atomic<int> ran = 0;
+	tz::job_counter counter;
+	source.request_stop();
+	tz::job_handle cancelled = tz::job_execute([&ran](){ran++;}, {.cancel = source.get_token(), .counter = &counter});
+	std::array<tz::job_handle, 1> deps{cancelled};
+	std::atomic<bool> dependent_ran = false;
+	tz::job_wait(tz::job_execute_after([&dependent_ran](){dependent_ran = true;}, deps));
+	tz::job_wait(counter);
+	tz_assert(tz::job_complete(cancelled), "cancelled job never completed");
+	tz_assert(ran == 0, "cancelled job ran anyway");
+	tz_assert(dependent_ran, "job depending on a cancelled job never ran");
+
+	// same goes for a job whose deadline has already passed.
+	tz::job_wait(tz::job_execute([&ran](){ran++;}, {.deadline = std::chrono::steady_clock::now() - std::chrono::seconds(1)}));
+	tz_assert(ran == 0, "job ran despite missing its deadline");
+	// ...but not for one with plenty of time left, or a token nobody has stopped.
+	std::stop_source unused;
+	tz::job_wait(tz::job_execute([&ran](){ran++;}, {.cancel = unused.get_token(), .deadline = std::chrono::steady_clock::now() + std::chrono::hours(1)}));
+	tz_assert(ran == 1, "job with an unexpired deadline did not run");
+
+	// a running job can notice it's been cancelled and bail out early.
+	std::stop_source running_source;
+	std::atomic<bool> started = false;
+	std::atomic<bool> noticed = false;
+	tz_assert(!tz::job_cancelled(), "job_cancelled() returned true outside of a job");
+	tz::job_handle running = tz::job_execute([&]()
+	{
+		started = true;
+		while(!tz::job_cancelled())
+		{
+			std::this_thread::yield();
+		}
+		noticed = true;
+	}, {.cancel = running_source.get_token()});
+	while(!started)
+	{
+		std::this_thread::yield();
+	}
+	running_source.request_stop();
+	tz::job_wait(running);
+	tz_assert(noticed, "running job did not notice its cancellation");
+}
+
+void test_parallel_reduce()
+{
+	for(std::size_t count : {std::size_t{0}, std::size_t{1}, std::size_t{1000}, std::size_t{1} << 20})
+	{
+		std::vector<std::uint64_t> values(count);
+		for(std::size_t i = 0; i < count; i++)
+		{
+			values[i] = (i * 2654435761u) % 1000;
+		}
+		const std::uint64_t expected = std::reduce(values.begin(), values.end(), std::uint64_t{0});
+		for(std::size_t grain : {std::size_t{0}, std::size_t{1}, std::size_t{777}})
+		{
+			if(grain == 1 && count > 1000)
+			{
+				continue;
+			}
+			const std::uint64_t sum = tz::job_parallel_reduce(values, std::uint64_t{0}, std::plus<std::uint64_t>{}, grain);
+			tz_assert(sum == expected, "parallel reduce of {} elements with grain {} gave {}, expected {}", count, grain, sum, expected);
+		}
+	}
+	// associative but not commutative - the order of elements must be preserved.
+	std::vector<std::string> letters;
+	for(std::size_t i = 0; i < 500; i++)
+	{
+		letters.push_back(std::string(1, static_cast<char>('a' + i % 26)));
+	}
+	const std::string expected = std::reduce(letters.begin(), letters.end(), std::string{});
+	const std::string concatenated = tz::job_parallel_reduce(letters, std::string{}, std::plus<std::string>{}, 7);
+	tz_assert(concatenated == expected, "parallel reduce did not preserve the order of a non-commutative operation");
+
+	// bool results, with many small blocks whose results are written at the same time.
+	std::vector<int> flags(4096, 0);
+	flags[3000] = 1;
+	const bool any = tz::job_parallel_reduce(flags, false, [](bool acc, int flag){return acc || flag != 0;}, 1);
+	tz_assert(any, "parallel reduce to a bool missed the only set flag");
+	const bool all = tz::job_parallel_reduce(flags, true, [](bool acc, int flag){return acc && flag != 0;}, 1);
+	tz_assert(!all, "parallel reduce to a bool found every flag set");
+}
+
+void test_parallel_scan()
+{
+	for(std::size_t count : {std::size_t{0}, std::size_t{1}, std::size_t{1000}, std::size_t{1} << 20})
+	{
+		std::vector<std::uint32_t> values(count);
+		for(std::size_t i = 0; i < count; i++)
+		{
+			// visibility flags, as you'd scan for stream compaction.
+			values[i] = (i * 2654435761u) % 3 == 0;
+		}
+		std::vector<std::uint32_t> expected(count);
+		std::vector<std::uint32_t> result(count);
+		std::exclusive_scan(values.begin(), values.end(), expected.begin(), 0u);
+		tz::job_parallel_scan(values, result, 0u, std::plus<std::uint32_t>{});
+		tz_assert(result == expected, "parallel exclusive scan of {} elements did not match std::exclusive_scan", count);
+
+		std::inclusive_scan(values.begin(), values.end(), expected.begin());
+		tz::job_parallel_scan(values, result, 0u, std::plus<std::uint32_t>{}, tz::job_scan_type::inclusive, 333);
+		tz_assert(result == expected, "parallel inclusive scan of {} elements did not match std::inclusive_scan", count);
+
+		// in-place.
+		std::exclusive_scan(values.begin(), values.end(), expected.begin(), 0u);
+		tz::job_parallel_scan(values, values, 0u, std::plus<std::uint32_t>{}, tz::job_scan_type::exclusive, 64);
+		tz_assert(values == expected, "in-place parallel exclusive scan of {} elements did not match std::exclusive_scan", count);
+	}
+	// bool results: running parity. the ranges themselves aren't std::vector<bool>, as blocks write to the output at the same time.
+	std::vector<std::uint8_t> bits(4096);
+	for(std::size_t i = 0; i < bits.size(); i++)
+	{
+		bits[i] = (i * 2654435761u) % 5 == 0;
+	}
+	std::vector<std::uint8_t> expected(bits.size());
+	std::vector<std::uint8_t> result(bits.size());
+	std::inclusive_scan(bits.begin(), bits.end(), expected.begin(), std::not_equal_to<bool>{});
+	tz::job_parallel_scan(bits, result, false, std::not_equal_to<bool>{}, tz::job_scan_type::inclusive, 1);
+	tz_assert(result == expected, "parallel scan to a bool did not match std::inclusive_scan");
+}
+
+void test_scratch()
+{
+	std::atomic<std::size_t> failures = 0;
+	for(int frame = 0; frame < 4; frame++)
+	{
+		tz::job_counter counter;
+		for(std::size_t i = 0; i < 64; i++)
+		{
+			tz::job_execute([&failures, i]()
+			{
+				// enough to overflow the first block and make the arena grow.
+				std::pmr::vector<std::size_t> values{tz::job_scratch()};
+				for(std::size_t j = 0; j < 20000; j++)
+				{
+					values.push_back(i + j);
+				}
+				std::pmr::vector<char> unaligned{100, 'x', tz::job_scratch()};
+				std::pmr::vector<double> aligned{100, 1.0, tz::job_scratch()};
+				if(reinterpret_cast<std::uintptr_t>(aligned.data()) % alignof(double) != 0)
+				{
+					failures++;
+				}
+				for(std::size_t j = 0; j < values.size(); j++)
+				{
+					if(values[j] != i + j)
+					{
+						failures++;
+						break;
+					}
+				}
+			}, counter);
+		}
+		tz::job_wait(counter);
+		tz::job_scratch_reset();
+	}
+	tz_assert(failures == 0, "{} jobs saw corrupted or misaligned scratch memory", failures.load());
+	tz_assert(tz::job_scratch() == tz::job_scratch(), "job_scratch() returned different allocators on the same thread");
+}
+
+#include "tz/main.hpp"
+int tz_main()
+{
+	tz::initialise();
+	test_execute_wait();
+	test_handle_reuse();
+	test_many_jobs();
+	test_nested_spawn();
+	test_nested_wait();
+	test_parallel_for();
+	test_execute_after();
+	test_job_graph();
+	test_priorities();
+	test_background_nested_wait();
+	test_nested_parallel_for_priority();
+	test_affine_jobs();
+	test_wait_runs_affine_work();
+	test_main_thread_jobs();
+	test_execute_batch();
+	test_stats();
+	test_counter();
+	test_cancellation();
+	test_parallel_reduce();
+	test_parallel_scan();
+	test_scratch();
+	tz::terminate();
+	return 0;
+}
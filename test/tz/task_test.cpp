@@ -0,0 +1,164 @@
+#include "tz/topaz.hpp"
+#include "tz/core/task.hpp"
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+
+std::atomic<int> stage = 0;
+
+tz::task<int> read_file()
+{
+	// pretend to do some slow i/o as a regular job, and suspend until it's done.
+	int data = 0;
+	co_await tz::job_execute([&data](){data = 5; stage++;});
+	co_return data;
+}
+
+tz::task<int> decode(int data)
+{
+	co_await tz::job_execute([](){stage++;});
+	co_return data * 2;
+}
+
+tz::task<> load_asset(int& out)
+{
+	int data = co_await read_file();
+	out = co_await decode(data);
+	stage++;
+}
+
+void test_task_chain()
+{
+	int result = 0;
+	tz::task<> t = load_asset(result);
+	tz_assert(!t.done(), "task started running before it was executed");
+	tz::job_wait(tz::task_execute(t));
+	tz_assert(t.done(), "task_execute handle completed before the task did");
+	tz_assert(result == 10, "task chain produced wrong result. Expected {}, got {}", 10, result);
+	tz_assert(stage == 3, "task chain skipped a stage. Expected {} stages, got {}", 3, stage.load());
+}
+
+tz::task<int> wait_on_flag(std::atomic<bool>& flag)
+{
+	// the job we await blocks until the flag is set. while suspended, the task must not be holding up a worker.
+	co_await tz::job_execute([&flag](){while(!flag.load()){std::this_thread::yield();}});
+	co_return 123;
+}
+
+void test_many_tasks()
+{
+	std::atomic<bool> flag = false;
+	std::vector<tz::task<int>> tasks;
+	std::vector<tz::job_handle> handles;
+	for(std::size_t i = 0; i < 64; i++)
+	{
+		tasks.push_back(wait_on_flag(flag));
+	}
+	for(tz::task<int>& t : tasks)
+	{
+		handles.push_back(tz::task_execute(t));
+	}
+	flag = true;
+	for(std::size_t i = 0; i < tasks.size(); i++)
+	{
+		tz::job_wait(handles[i]);
+		tz_assert(tasks[i].get() == 123, "task {} returned wrong value. Expected {}, got {}", i, 123, tasks[i].get());
+	}
+}
+
+tz::task<> await_gate(std::atomic<bool>& started, std::atomic<bool>& gate, std::atomic<bool>& resumed)
+{
+	started = true;
+	co_await tz::job_execute([&gate](){while(!gate.load()){std::this_thread::yield();}});
+	resumed = true;
+}
+
+void test_task_priority()
+{
+	if(tz::job_worker_count() < 3)
+	{
+		// need a worker for the hog, one for the gate job, and one left over to (not) resume the task.
+		return;
+	}
+	const std::size_t old_limit = tz::job_background_worker_limit();
+	tz::job_set_background_worker_limit(1);
+	// get a background task suspended on a job.
+	std::atomic<bool> started = false;
+	std::atomic<bool> gate = false;
+	std::atomic<bool> resumed = false;
+	tz::task<> t = await_gate(started, gate, resumed);
+	tz::job_handle done = tz::task_execute(t, tz::job_priority::background);
+	while(!started.load())
+	{
+		std::this_thread::yield();
+	}
+	// hog the only place in the background lane.
+	std::atomic<bool> release = false;
+	std::atomic<bool> hogging = false;
+	tz::job_handle hog = tz::job_execute([&release, &hogging]()
+	{
+		hogging = true;
+		while(!release.load())
+		{
+			std::this_thread::yield();
+		}
+	}, tz::job_priority::background);
+	while(!hogging.load())
+	{
+		std::this_thread::yield();
+	}
+	// the task must be resumed as background work, so it's stuck behind the hog.
+	gate = true;
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	tz_assert(!resumed.load(), "background task was resumed at a higher priority after co_await");
+	release = true;
+	tz::job_wait(hog);
+	tz::job_wait(done);
+	tz_assert(resumed.load(), "background task never resumed");
+	tz::job_set_background_worker_limit(old_limit);
+}
+
+tz::task<> sleep_briefly()
+{
+	co_await tz::job_execute([](){std::this_thread::sleep_for(std::chrono::milliseconds(10));}, tz::job_priority::realtime);
+}
+
+void test_task_completion_priority()
+{
+	// a realtime task finishes while a backlog of realtime jobs is queued. whoever is waiting on the task must hear about it straight away, not once the backlog has cleared.
+	tz::task<> t = sleep_briefly();
+	tz::job_handle done = tz::task_execute(t, tz::job_priority::realtime);
+	std::atomic<std::size_t> backlog_done = 0;
+	std::vector<tz::job_handle> backlog;
+	for(std::size_t i = 0; i < tz::job_worker_count() * 64; i++)
+	{
+		backlog.push_back(tz::job_execute([&backlog_done]()
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			backlog_done++;
+		}, tz::job_priority::realtime));
+	}
+	while(!tz::job_complete(done))
+	{
+		std::this_thread::yield();
+	}
+	const std::size_t done_before = backlog_done.load();
+	for(tz::job_handle job : backlog)
+	{
+		tz::job_wait(job);
+	}
+	tz_assert(done_before < backlog.size() / 2, "realtime task's completion was held up until {} of {} realtime jobs submitted after it had finished", done_before, backlog.size());
+}
+
+#include "tz/main.hpp"
+int tz_main()
+{
+	tz::initialise();
+	test_task_chain();
+	test_many_tasks();
+	test_task_priority();
+	test_task_completion_priority();
+	tz::terminate();
+	return 0;
+}